@@ -0,0 +1,80 @@
+import mmap
+import struct
+
+# Reader of the binary finger graphs written by `finger-graph build --binary`
+# (see src/graph_file.h for the layout). The file is mapped in memory and
+# nothing is read until it is accessed.
+
+HEADER = struct.Struct('<8sIIiBBBB13Q')
+KEY = struct.Struct('<QIB3x')
+VERSION = 1
+
+
+class GraphFile:
+    def __init__(self, filename):
+        with open(filename, 'rb') as f:
+            self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        if len(self.data) < HEADER.size:
+            raise Exception("%s is truncated or corrupted" % filename)
+
+        (magic, version, self.k, self.limit, is_normalized, is_directed, is_enriched, enriched_kfingers,
+         self.n_nodes, self.n_occurrences, self.n_edges, self.n_reads, names_length,
+         keys, kfingers, occurrence_offsets, occurrences, edge_offsets, edges, name_offsets, names) = \
+            HEADER.unpack_from(self.data)
+        if magic != b'LYNDONFG' or version != VERSION:
+            raise Exception("Not a finger graph file of version %d" % VERSION)
+
+        # Every section must be aligned and lie within the file
+        sections = [
+            (keys, self.n_nodes, KEY.size), (kfingers, self.n_nodes, 4 * self.k),
+            (occurrence_offsets, self.n_nodes + 1, 8), (occurrences, self.n_occurrences, 8),
+            (edge_offsets, self.n_nodes + 1, 8), (edges, self.n_edges, 4),
+            (name_offsets, self.n_reads + 1, 8), (names, names_length, 1),
+        ]
+        if self.k < 1 or any(offset % 8 != 0 or offset + n * size > len(self.data) for offset, n, size in sections):
+            raise Exception("%s is truncated or corrupted" % filename)
+
+        self.is_normalized = bool(is_normalized)
+        self.is_directed = bool(is_directed)
+        self.is_enriched = bool(is_enriched)
+        self.enriched_kfingers = bool(enriched_kfingers)
+
+        view = memoryview(self.data)
+        self._keys = keys
+        self._kfingers = view[kfingers:kfingers + 4 * self.n_nodes * self.k].cast('I')
+        self._occurrence_offsets = view[occurrence_offsets:occurrence_offsets + 8 * (self.n_nodes + 1)].cast('Q')
+        self._occurrences = view[occurrences:occurrences + 8 * self.n_occurrences].cast('i')
+        self._edge_offsets = view[edge_offsets:edge_offsets + 8 * (self.n_nodes + 1)].cast('Q')
+        self._edges = view[edges:edges + 4 * self.n_edges].cast('I')
+        self._name_offsets = view[name_offsets:name_offsets + 8 * (self.n_reads + 1)].cast('Q')
+        self._names = names
+
+        for offsets, count in ((self._occurrence_offsets, self.n_occurrences), (self._edge_offsets, self.n_edges),
+                               (self._name_offsets, names_length)):
+            if offsets[0] != 0 or offsets[-1] != count:
+                raise Exception("%s is truncated or corrupted" % filename)
+
+    def __len__(self):
+        return self.n_nodes
+
+    def key(self, node):
+        """Key of a node, as in the text format: ((kf_1, ..., kf_k), 'key_seq')"""
+        key_bases, key_n_mask, key_length = KEY.unpack_from(self.data, self._keys + KEY.size * node)
+        seq = ''.join('N' if key_n_mask >> i & 1 else "ACGT"[key_bases >> 2 * (key_length - 1 - i) & 3]
+                      for i in range(key_length))
+        return tuple(self._kfingers[node * self.k:(node + 1) * self.k]), seq
+
+    def read_name(self, r_id):
+        begin = self._names + self._name_offsets[r_id]
+        end = self._names + self._name_offsets[r_id + 1]
+        return self.data[begin:end].decode('utf-8')
+
+    def occurrences(self, node):
+        """List of the (read_id, offset) of a node"""
+        begin, end = self._occurrence_offsets[node], self._occurrence_offsets[node + 1]
+        return [(self.read_name(self._occurrences[2 * i] & 0xffffffff), self._occurrences[2 * i + 1])
+                for i in range(begin, end)]
+
+    def neighbours(self, node):
+        """Indices of the nodes adjacent to a node"""
+        return self._edges[self._edge_offsets[node]:self._edge_offsets[node + 1]].tolist()
@@ -0,0 +1,128 @@
+#include "components.h"
+#include "parallel.h"
+#include "union_find.h"
+#include "utils.h"
+#include <algorithm>
+
+Lyndon::Components::Components(const Lyndon::FingerGraph &graph, int threads, bool join_reads)
+    : graph(graph), nodes(graph) {
+    auto n = this->nodes.size();
+    Lyndon::UnionFind sets(n);
+    Lyndon::parallel_for_blocks(threads, n, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::uint32_t i = begin; i < end; i++) {
+            for (const Node* n2 : this->nodes[i]->adj_list) {
+                auto j = this->nodes.find(n2);
+                if (j != NodeIndex::NONE) {
+                    sets.unite(i, j);
+                }
+            }
+        }
+    });
+
+    if (join_reads) {
+        // The first node claiming a read is united with all the others it occurs in
+        std::vector<std::atomic<std::uint32_t>> claims(graph.reads.size());
+        for (auto &claim : claims) {
+            claim.store(NodeIndex::NONE, std::memory_order_relaxed);
+        }
+        Lyndon::parallel_for_blocks(threads, n, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::uint32_t i = begin; i < end; i++) {
+                for (const auto &occ : this->nodes[i]->occs) {
+                    auto claim = NodeIndex::NONE;
+                    if (!claims[occ.r_id].compare_exchange_strong(claim, i, std::memory_order_relaxed)) {
+                        sets.unite(i, claim);
+                    }
+                }
+            }
+        });
+        this->read_node.resize(claims.size());
+        for (std::size_t r = 0; r < claims.size(); r++) {
+            this->read_node[r] = claims[r].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Roots are numbered by decreasing size of their set, then by their first
+    // node (as the roots themselves depend on the order of the unions), and the
+    // nodes are sorted by component with a counting sort
+    std::vector<std::uint32_t> root(n), set_size(n, 0), roots;
+    for (std::uint32_t i = 0; i < n; i++) {
+        root[i] = sets.find(i);
+        if (set_size[root[i]]++ == 0) {
+            roots.push_back(root[i]);
+        }
+    }
+    std::stable_sort(roots.begin(), roots.end(), [&set_size](std::uint32_t x, std::uint32_t y) {
+        return set_size[x] > set_size[y];
+    });
+
+    std::vector<std::uint32_t> number(n);
+    this->first.assign(1, 0);
+    for (std::uint32_t c = 0; c < roots.size(); c++) {
+        number[roots[c]] = c;
+        this->first.push_back(this->first.back() + set_size[roots[c]]);
+    }
+    this->component.resize(n);
+    this->sorted_nodes.resize(n);
+    std::vector<std::uint32_t> next(this->first.begin(), this->first.end() - 1);
+    for (std::uint32_t i = 0; i < n; i++) {
+        this->component[i] = number[root[i]];
+        this->sorted_nodes[next[this->component[i]]++] = i;
+    }
+}
+
+Lyndon::Range<std::uint32_t> Lyndon::Components::members(std::uint32_t c) const {
+    return Lyndon::Range<std::uint32_t> { this->sorted_nodes.data() + this->first[c], this->first[c + 1] - this->first[c] };
+}
+
+void Lyndon::Components::save(std::ostream &out, int threads) const {
+    const auto &reads = this->graph.reads;
+
+    // Components are formatted a block at a time
+    write_blocks(out, threads, block_count(size()), [&](std::size_t block, std::string &buffer) {
+        std::vector<std::uint32_t> component_reads;
+        auto end = std::min<std::size_t>(size(), (block + 1) * BLOCK_SIZE);
+        for (auto c = block * BLOCK_SIZE; c < end; c++) {
+            component_reads.clear();
+            for (auto node : members(c)) {
+                for (const auto &occ : this->nodes[node]->occs) {
+                    component_reads.push_back(occ.r_id);
+                }
+            }
+            std::sort(component_reads.begin(), component_reads.end());
+            component_reads.erase(std::unique(component_reads.begin(), component_reads.end()), component_reads.end());
+
+            append_int(buffer, c);
+            buffer += '\t';
+            append_int(buffer, members(c).size());
+            buffer += '\t';
+            append_int(buffer, component_reads.size());
+            buffer += '\t';
+            for (std::size_t r = 0; r < component_reads.size(); r++) {
+                if (r > 0) {
+                    buffer += ' ';
+                }
+                buffer.append(reads.name(component_reads[r]), reads.length(component_reads[r]));
+            }
+            buffer += '\n';
+        }
+    });
+}
+
+void Lyndon::Components::save_clusters(std::ostream &out) const {
+    const auto &reads = this->graph.reads;
+    std::string buffer;
+    for (std::uint32_t r = 0; r < this->read_node.size(); r++) {
+        if (this->read_node[r] == NodeIndex::NONE) {
+            continue;
+        }
+        buffer.append(reads.name(r), reads.length(r));
+        buffer += '\t';
+        append_int(buffer, this->component[this->read_node[r]]);
+        buffer += '\n';
+        if (buffer.length() >= 1 << 20) {
+            out.write(buffer.data(), buffer.length());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.length());
+}
@@ -0,0 +1,45 @@
+#ifndef LYNDON_COMPONENTS_H
+#define LYNDON_COMPONENTS_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "finger_graph.h"
+
+namespace Lyndon {
+    // Connected components of the nodes of a frozen graph which save() prints
+    // (those with at least two occurrences), over the edges between them and
+    // regardless of their direction. Components are numbered by decreasing
+    // number of nodes, then by their first node.
+    class Components {
+    public:
+        // With `join_reads`, nodes occurring in the same read are connected too,
+        // so that every read belongs to a single component (its cluster)
+        Components(const FingerGraph &graph, int threads = 1, bool join_reads = false);
+
+        std::uint32_t size() const { return first.size() - 1; }
+        // Nodes of component c, as numbers of `nodes`
+        Range<std::uint32_t> members(std::uint32_t c) const;
+        std::uint32_t component_of(std::uint32_t node) const { return component[node]; }
+
+        // Writes a line `component\tnodes\treads\tread_id1 read_id2 ...` per
+        // component, listing the reads occurring in its nodes
+        void save(std::ostream &out, int threads = 1) const;
+        // Writes a line `read_id\tcomponent` per read occurring in the nodes, in
+        // the order of their names. Needs `join_reads`.
+        void save_clusters(std::ostream &out) const;
+
+        const FingerGraph &graph;
+        NodeIndex nodes;
+
+    private:
+        std::vector<std::uint32_t> component;
+        // Nodes sorted by component, component c being sorted_nodes[first[c], first[c + 1])
+        std::vector<std::uint32_t> sorted_nodes;
+        std::vector<std::uint32_t> first;
+        // With `join_reads`, a node each read occurs in (or NodeIndex::NONE)
+        std::vector<std::uint32_t> read_node;
+    };
+}
+
+#endif //LYNDON_COMPONENTS_H
@@ -0,0 +1,66 @@
+#ifndef LYNDON_COUNTING_FILTER_H
+#define LYNDON_COUNTING_FILTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace Lyndon {
+    // Counting Bloom filter with 2-bit saturating counters, packed 32 per word
+    // and updated with atomic operations, so that any number of threads can add
+    // to it at once. count(h) never underestimates how many times h was added
+    // (up to 3).
+    class CountingFilter {
+    public:
+        static const int N_HASHES = 3;
+
+        explicit CountingFilter(int log2_counters)
+            : mask((std::uint64_t(1) << log2_counters) - 1), words(((std::uint64_t(1) << log2_counters) + 31) / 32) {
+            for (auto &word : words) {
+                word.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void add(std::uint64_t h) {
+            std::uint64_t step = mix(h) | 1;
+            for (int i = 0; i < N_HASHES; i++, h += step) {
+                auto counter = h & mask;
+                auto &word = words[counter / 32];
+                int shift = 2 * (counter % 32);
+                auto value = word.load(std::memory_order_relaxed);
+                while (((value >> shift) & 3) != 3 &&
+                       !word.compare_exchange_weak(value, value + (std::uint64_t(1) << shift), std::memory_order_relaxed)) { }
+            }
+        }
+
+        int count(std::uint64_t h) const {
+            std::uint64_t step = mix(h) | 1;
+            int result = 3;
+            for (int i = 0; i < N_HASHES; i++, h += step) {
+                auto counter = h & mask;
+                auto value = words[counter / 32].load(std::memory_order_relaxed);
+                int c = (value >> 2 * (counter % 32)) & 3;
+                if (c < result) {
+                    result = c;
+                }
+            }
+            return result;
+        }
+
+    private:
+        // Second, independent hash for double hashing
+        static std::uint64_t mix(std::uint64_t h) {
+            h ^= h >> 31;
+            h *= 0x7fb5d329728ea185ULL;
+            h ^= h >> 27;
+            h *= 0x81dadef4bc2dd44dULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        std::uint64_t mask;
+        std::vector<std::atomic<std::uint64_t>> words;
+    };
+}
+
+#endif //LYNDON_COUNTING_FILTER_H
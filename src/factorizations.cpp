@@ -3,27 +3,289 @@
 //
 
 #include "factorizations.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace {
+    // Views over the read: the factorizers are templates on how the i-th base is
+    // fetched, so the *_comb variants can factorize the reverse complement
+    // without ever building it.
+    struct Forward {
+        const char *s;
+
+        char operator[](int i) const { return s[i]; }
+    };
+
+    struct ReverseComplement {
+        const char *s;
+        int n;
+
+        char operator[](int i) const { return complement(s[n - 1 - i]); }
+    };
+
+    // Duval's algorithm. The outer loop emits every copy of the Lyndon word found by
+    // the inner loop before moving on, instead of restarting after the first copy as
+    // `duval_` in factorization.py does, so the whole factorization is linear.
+    // Each factor is passed to `emit` as (start, length) as soon as it is found.
+    template <class Seq, class Emit> void duval(const Seq &s, int n, Emit emit) {
+        int i = 0;
+        while (i < n) {
+            int j = i + 1, k = i;
+            while (j < n && s[k] <= s[j]) {
+                if (s[k] < s[j]) {
+                    k = i;
+                } else {
+                    k++;
+                }
+                j++;
+            }
+
+            while (i <= k) {
+                emit(i, j - k);
+                i += j - k;
+            }
+        }
+    }
+
+    // ICFL of s[begin, begin + n), as `icfl_` in factorization.py, without the recursion.
+    // icfl(w) only recurses on the suffix v of w = pv, where p is the prefix found by
+    // `find_prefix`/`find_bre`, and then either prepends p to the result or glues it
+    // to its first factor, depending on |r| (p' = rb being the bounded right
+    // extension of p). The first loop walks the chain of suffixes storing (|p|, |r|)
+    // for each of them; the second one replays the decisions from the last suffix,
+    // which is an inverse Lyndon word, back to w, so the factors come out reversed.
+    template <class Seq> void inverse_duval(const Seq &s, int begin, int n, Lyndon::fingerprint &lengths,
+                                            Lyndon::FactorizationWorkspace &ws) {
+        if (n == 0) {
+            return;
+        }
+        if (ws.failure.size() < (std::size_t) n) {
+            ws.failure.resize(n);
+        }
+        ws.levels.clear();
+
+        int start = begin;
+        while (true) {
+            int m = begin + n - start;
+            if (m == 1) {
+                break;
+            }
+
+            // find_prefix
+            int i = 0, j = 1;
+            while (j < m - 1 && s[start + j] <= s[start + i]) {
+                if (s[start + j] < s[start + i]) {
+                    i = 0;
+                } else {
+                    i++;
+                }
+                j++;
+            }
+            if (j == m - 1 && s[start + j] <= s[start + i]) {
+                break;
+            }
+
+            // find_bre: smallest border r of w[0, j) such that w[|r|] < w[j]
+            int *f = ws.failure.data();
+            f[0] = 0;
+            for (int a = 1, b = 0; a < j; ) {
+                if (s[start + a] == s[start + b]) {
+                    f[a++] = ++b;
+                } else if (b > 0) {
+                    b = f[b - 1];
+                } else {
+                    f[a++] = 0;
+                }
+            }
+            int r = j;
+            for (int a = j - 1; a >= 0; a = f[a] - 1) {
+                if (s[start + f[a]] < s[start + j]) {
+                    r = f[a];
+                }
+            }
+
+            ws.levels.push_back(j - r);
+            ws.levels.push_back(r);
+            start += j - r;
+        }
+
+        auto first = lengths.size();
+        int head = begin + n - start;
+        for (int l = (int) ws.levels.size() - 2; l >= 0; l -= 2) {
+            int p = ws.levels[l], r = ws.levels[l + 1];
+            if (head > r) {
+                lengths.push_back(head);
+                head = p;
+            } else {
+                head += p;
+            }
+        }
+        lengths.push_back(head);
+        std::reverse(lengths.begin() + first, lengths.end());
+    }
+
+    template <class Seq> void duval_icfl(const Seq &s, int n, Lyndon::fingerprint &lengths,
+                                         Lyndon::FactorizationWorkspace &ws, int cfl_max) {
+        duval(s, n, [&](int start, int length) {
+            if (length > cfl_max) {
+                inverse_duval(s, start, length, lengths, ws);
+            } else {
+                lengths.push_back(length);
+            }
+        });
+    }
+
+    // Merge of the factorizations of a read and of its reverse complement, as
+    // `d_duval_` in factorization.py: the result is cut wherever either of them
+    // is. `forward` is read left to right, `reverse` (which lists the factors of
+    // the reverse complement, i.e. of the read from its end) right to left.
+    void merge(const Lyndon::fingerprint &forward, const Lyndon::fingerprint &reverse, Lyndon::fingerprint &lengths) {
+        auto f = forward.begin();
+        auto r = reverse.rbegin();
+        int f_left = 0, r_left = 0;
+        if (f != forward.end()) f_left = *f;
+        if (r != reverse.rend()) r_left = *r;
+
+        while (f != forward.end() && r != reverse.rend()) {
+            if (f_left < r_left) {
+                lengths.push_back(f_left);
+                r_left -= f_left;
+                if (++f != forward.end()) f_left = *f;
+            } else {
+                lengths.push_back(r_left);
+                f_left -= r_left;
+                if (f_left == 0 && ++f != forward.end()) f_left = *f;
+                if (++r != reverse.rend()) r_left = *r;
+            }
+        }
+
+        while (f != forward.end()) {
+            lengths.push_back(f_left);
+            if (++f != forward.end()) f_left = *f;
+        }
+        while (r != reverse.rend()) {
+            lengths.push_back(r_left);
+            if (++r != reverse.rend()) r_left = *r;
+        }
+    }
+}
+
+void cfl(const char *s, int n, Lyndon::fingerprint &lengths) {
+    duval(Forward { s }, n, [&lengths](int, int length) {
+        lengths.push_back(length);
+    });
+}
+
+void icfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws) {
+    inverse_duval(Forward { s }, 0, n, lengths, ws);
+}
+
+// CFL refined by ICFL, as `cfl_icfl_` in factorization.py: every Lyndon factor
+// longer than cfl_max is replaced by its inverse factorization as soon as Duval
+// finds it, so no intermediate list of factors is ever built.
+void cfl_icfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws, int cfl_max) {
+    duval_icfl(Forward { s }, n, lengths, ws, cfl_max);
+}
+
+void d_cfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws) {
+    ws.forward.clear();
+    ws.reverse.clear();
+    cfl(s, n, ws.forward);
+    duval(ReverseComplement { s, n }, n, [&ws](int, int length) {
+        ws.reverse.push_back(length);
+    });
+    merge(ws.forward, ws.reverse, lengths);
+}
+
+void d_icfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws) {
+    ws.forward.clear();
+    ws.reverse.clear();
+    icfl(s, n, ws.forward, ws);
+    inverse_duval(ReverseComplement { s, n }, 0, n, ws.reverse, ws);
+    merge(ws.forward, ws.reverse, lengths);
+}
+
+void d_cfl_icfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws, int cfl_max) {
+    ws.forward.clear();
+    ws.reverse.clear();
+    cfl_icfl(s, n, ws.forward, ws, cfl_max);
+    duval_icfl(ReverseComplement { s, n }, n, ws.reverse, ws, cfl_max);
+    merge(ws.forward, ws.reverse, lengths);
+}
+
+factorization_function get_factorization_function(const std::string &name) {
+    if (name == "cfl") {
+        return [](const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &) {
+            cfl(s, n, lengths);
+        };
+    }
+    if (name == "icfl") {
+        return icfl;
+    }
+    if (name == "cfl_icfl") {
+        return [](const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws) {
+            cfl_icfl(s, n, lengths, ws);
+        };
+    }
+    if (name == "cfl_comb") {
+        return d_cfl;
+    }
+    if (name == "icfl_comb") {
+        return d_icfl;
+    }
+    if (name == "cfl_icfl_comb") {
+        return [](const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws) {
+            d_cfl_icfl(s, n, lengths, ws);
+        };
+    }
+    return nullptr;
+}
+
+void factorize_batch(factorization_function alg, const char *const *s, const int *n, std::size_t count,
+                     Lyndon::FactorizationBatch &batch) {
+    for (std::size_t r = 0; r < count; r++) {
+        alg(s[r], n[r], batch.lengths, batch.ws);
+        batch.offsets.push_back(batch.lengths.size());
+    }
+}
 
 Lyndon::factorization cfl(const std::string &s) {
-    return Lyndon::factorization();
+    Lyndon::fingerprint lengths;
+    cfl(s.data(), s.length(), lengths);
+    return fingerprint2facts(s, lengths);
 }
 
 Lyndon::factorization icfl(const std::string &s) {
-    return Lyndon::factorization();
+    Lyndon::fingerprint lengths;
+    Lyndon::FactorizationWorkspace ws;
+    icfl(s.data(), s.length(), lengths, ws);
+    return fingerprint2facts(s, lengths);
 }
 
-Lyndon::factorization cfl_icfl(const std::string &s) {
-    return Lyndon::factorization();
+Lyndon::factorization cfl_icfl(const std::string &s, int cfl_max) {
+    Lyndon::fingerprint lengths;
+    Lyndon::FactorizationWorkspace ws;
+    cfl_icfl(s.data(), s.length(), lengths, ws, cfl_max);
+    return fingerprint2facts(s, lengths);
 }
 
 Lyndon::factorization d_cfl(const std::string &s) {
-    return Lyndon::factorization();
+    Lyndon::fingerprint lengths;
+    Lyndon::FactorizationWorkspace ws;
+    d_cfl(s.data(), s.length(), lengths, ws);
+    return fingerprint2facts(s, lengths);
 }
 
 Lyndon::factorization d_icfl(const std::string &s) {
-    return Lyndon::factorization();
+    Lyndon::fingerprint lengths;
+    Lyndon::FactorizationWorkspace ws;
+    d_icfl(s.data(), s.length(), lengths, ws);
+    return fingerprint2facts(s, lengths);
 }
 
-Lyndon::factorization d_cfl_icfl(const std::string &s) {
-    return Lyndon::factorization();
+Lyndon::factorization d_cfl_icfl(const std::string &s, int cfl_max) {
+    Lyndon::fingerprint lengths;
+    Lyndon::FactorizationWorkspace ws;
+    d_cfl_icfl(s.data(), s.length(), lengths, ws, cfl_max);
+    return fingerprint2facts(s, lengths);
 }
@@ -3,11 +3,64 @@
 
 #include "finger_graph.h"
 
+namespace Lyndon {
+    // Scratch buffers of the native factorizations. They only grow, so a caller
+    // reusing the same workspace across reads stops allocating once it has seen
+    // its longest read.
+    struct FactorizationWorkspace {
+        std::vector<int> failure; // failure function of the current ICFL prefix
+        std::vector<int> levels;  // (|p|, |r|) pairs of the ICFL prefixes, flattened
+        fingerprint forward;      // factors of the read, for the *_comb variants
+        fingerprint reverse;      // factors of its reverse complement
+    };
+
+    // Factorizations of a batch of reads, back to back: the factors of read r have
+    // lengths[offsets[r], offsets[r + 1]). As the workspace, it only grows, so a
+    // caller reusing the same batch stops allocating once it has seen its largest
+    // batch of reads.
+    struct FactorizationBatch {
+        fingerprint lengths;
+        std::vector<std::size_t> offsets;
+        FactorizationWorkspace ws;
+
+        FactorizationBatch() : offsets(1, 0) { }
+
+        void clear() {
+            lengths.clear();
+            offsets.resize(1);
+        }
+        std::size_t size() const { return offsets.size() - 1; }
+        Range<int> factors(std::size_t r) const {
+            return Range<int> { lengths.data() + offsets[r], (std::uint32_t) (offsets[r + 1] - offsets[r]) };
+        }
+    };
+}
+
+// The native factorizations do not copy the factors: they append the length of
+// each factor of s[0, n) to `lengths` (i.e. the fingerprint of s), the factors
+// being the consecutive slices of s of those lengths.
+void cfl(const char *s, int n, Lyndon::fingerprint &lengths);
+void icfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws);
+void cfl_icfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws, int cfl_max = 30);
+void d_cfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws);
+void d_icfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws);
+void d_cfl_icfl(const char *s, int n, Lyndon::fingerprint &lengths, Lyndon::FactorizationWorkspace &ws, int cfl_max = 30);
+
+// Factorization named as the `-a` choices of `lfg compute-factorizations`
+// (cfl_icfl variants with the default cfl_max), or nullptr if there is none.
+typedef void (*factorization_function)(const char *s, int n, Lyndon::fingerprint &lengths,
+                                       Lyndon::FactorizationWorkspace &ws);
+factorization_function get_factorization_function(const std::string &name);
+
+// Appends to `batch` the factorizations with `alg` of the `count` reads s[r][0, n[r])
+void factorize_batch(factorization_function alg, const char *const *s, const int *n, std::size_t count,
+                     Lyndon::FactorizationBatch &batch);
+
 Lyndon::factorization cfl(const std::string &s);
 Lyndon::factorization icfl(const std::string &s);
-Lyndon::factorization cfl_icfl(const std::string &s);
+Lyndon::factorization cfl_icfl(const std::string &s, int cfl_max = 30);
 Lyndon::factorization d_cfl(const std::string &s);
 Lyndon::factorization d_icfl(const std::string &s);
-Lyndon::factorization d_cfl_icfl(const std::string &s);
+Lyndon::factorization d_cfl_icfl(const std::string &s, int cfl_max = 30);
 
 #endif //LYNDON_NEW_FACTORIZATIONS_H
@@ -0,0 +1,45 @@
+#include "fastx.h"
+#include "utils.h"
+
+Lyndon::FastxReader::FastxReader(const std::string &path) : in(path.c_str()), has_line(false) { }
+
+bool Lyndon::FastxReader::is_open() {
+    return in.rdbuf()->is_open();
+}
+
+bool Lyndon::FastxReader::next(Lyndon::SequenceRecord &record) {
+    if (!has_line) {
+        do {
+            if (!std::getline(in, line)) {
+                return false;
+            }
+        } while (line.empty());
+    }
+    has_line = false;
+
+    char type = line[0];
+    if (type != '>' && type != '@') {
+        fprintf(stderr, "Error while reading sequences. File corrupted.\n");
+        abort();
+    }
+    auto id_end = line.find_first_of(" \t\r", 1);
+    record.id.assign(line, 1, id_end == std::string::npos ? std::string::npos : id_end - 1);
+    record.seq.clear();
+
+    if (type == '@') {
+        std::getline(in, record.seq);
+        rtrim(record.seq);
+        std::getline(in, line); // +
+        std::getline(in, line); // qualities
+        return true;
+    }
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && line[0] == '>') {
+            has_line = true;
+            break;
+        }
+        record.seq += rtrim(line);
+    }
+    return true;
+}
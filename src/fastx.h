@@ -0,0 +1,30 @@
+#ifndef LYNDON_FASTX_H
+#define LYNDON_FASTX_H
+
+#include <string>
+#include "gzstream.h"
+
+namespace Lyndon {
+    struct SequenceRecord {
+        std::string id;
+        std::string seq;
+    };
+
+    // Reader of FASTA (also multi-line) and FASTQ files, plain or gzipped; the
+    // format is detected from the first record. As Biopython's `record.id`, the id
+    // of a record is its header up to the first whitespace.
+    class FastxReader {
+    public:
+        explicit FastxReader(const std::string &path);
+
+        bool is_open();
+        bool next(SequenceRecord &record);
+
+    private:
+        igzstream in;
+        std::string line;
+        bool has_line;
+    };
+}
+
+#endif //LYNDON_FASTX_H
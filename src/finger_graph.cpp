@@ -2,131 +2,479 @@
 #include "gzstream.h"
 #include "finger_graph.h"
 #include "utils.h"
+#include "parallel.h"
+#include "counting_filter.h"
+#include "graph_file.h"
+#include <algorithm>
+#include <cstring>
+
+Lyndon::FingerGraph::FingerGraph() : k(0), limit(0), is_normalized(false), is_directed(true), is_enriched(false),
+    enriched_kfingers(true), shards(N_SHARDS) { }
+
+Lyndon::FingerGraph::FingerGraph(int k, int limit, bool normalize, bool enriched_kfingers)
+    : k(k), limit(limit), is_normalized(normalize), is_directed(!normalize), is_enriched(!enriched_kfingers),
+      enriched_kfingers(enriched_kfingers), shards(N_SHARDS) { }
+
+Lyndon::FingerGraph::FingerGraph(std::istream &in, int k, int limit, bool normalize, bool enriched_kfingers, int threads)
+    : FingerGraph(k, limit, normalize, enriched_kfingers) {
+    add_reads(in, threads);
+    freeze(threads);
+}
 
-Lyndon::FingerGraph::FingerGraph(std::istream &in, int k, int limit, bool normalize, bool enriched_kfingers)
-    : k(k), limit(limit), is_normalized(normalize), is_directed(!normalize), is_enriched(!enriched_kfingers) {
-    std::string line; int c = 0;
-    while (std::getline(in, line)) {
-        auto split_line = split(line, '|');
-        if (split_line.size() < 2) { continue; }
-
-        auto read_id_offset = split(split_line[0], ' ');
-        auto read_id = read_id_offset[0];
-        auto offset = std::stoi(read_id_offset[1]);
-        auto factors = split(split_line[1], ' ');
-        auto fp = facts2fingerprint(factors);
-
-        int idx = 0;
-        while (idx + k < fp.size()) {
-            auto kfL = slice(fp, idx, idx + k);
-            auto key_seqL = enriched_kfingers ? Lyndon::get_key_factor(factors, idx, idx + k, this->is_normalized) : "";
-
-            auto kfR = slice(fp, idx + 1, idx + k + 1);
-            auto key_seqR = enriched_kfingers ? Lyndon::get_key_factor(factors, idx + 1, idx + k + 1, this->is_normalized) : "";
-
-            if (sum(kfL) < limit || sum(kfR) < limit) {
-                offset += fp[idx];
-                idx++;
-                continue;
+namespace {
+    // Calls f(read_id, offset, factors) on every line of a factorizations file
+    template <class F> void for_each_factorization(std::istream &in, int threads, F f) {
+        auto lines = std::vector<FactorizationLine>(std::max(threads, 1));
+        auto read_ids = std::vector<Lyndon::read_id>(lines.size());
+        std::string rest;
+
+        Lyndon::process_batches<std::vector<char>>(threads, [&in, &rest](std::vector<char> &chunk) {
+            return read_chunk(in, chunk, rest);
+        }, [&](std::vector<char> &chunk, int t) {
+            for_each_line(chunk, [&](const char *begin, const char *end) {
+                if (!parse_factorization_line(begin, end, lines[t])) {
+                    return;
+                }
+                read_ids[t].assign(lines[t].read_id, lines[t].read_id_length);
+                f(read_ids[t], lines[t].offset, lines[t].factors);
+            });
+        });
+    }
+}
+
+void Lyndon::FingerGraph::add_reads(std::istream &in, int threads) {
+    for_each_factorization(in, threads, [this](const Lyndon::read_id &r_id, int offset, const Lyndon::factor_spans &factors) {
+        add_read(r_id, offset, factors);
+    });
+}
+
+void Lyndon::FingerGraph::count_reads(std::istream &in, int threads) {
+    for_each_factorization(in, threads, [this](const Lyndon::read_id &, int, const Lyndon::factor_spans &factors) {
+        count_read(factors);
+    });
+}
+
+namespace {
+    const std::uint64_t HASH_BASE = 0x100000001b3ULL;
+
+    // Inverse of an odd x modulo 2^64 (Newton's iteration, each step doubles the correct bits)
+    std::uint64_t inverse(std::uint64_t x) {
+        std::uint64_t y = x;
+        for (int i = 0; i < 5; i++) {
+            y *= 2 - x * y;
+        }
+        return y;
+    }
+
+    // k-finger window sliding over the factors of a read. Each step updates in
+    // O(1) the sum of the window, the polynomial hashes of its k-finger read
+    // forwards and backwards (the latter being the hash of the reversed
+    // k-finger, used when normalizing) and the position of its longest factor,
+    // kept with a monotonic queue of the candidates.
+    class KFingerWindow {
+    public:
+        int begin, sum;
+
+        void reset(const Lyndon::factor_spans &factors, int k) {
+            this->factors = &factors;
+            this->k = k;
+            // get_key_factor: the longest factor is looked for in the interior of the window if k > 3
+            this->trim = k > 3 ? 1 : 0;
+            this->power = 1;
+            for (int i = 1; i < k; i++) {
+                this->power *= HASH_BASE;
+            }
+            this->inverse_base = inverse(HASH_BASE);
+
+            begin = 0;
+            sum = 0;
+            forward = backward = 0;
+            std::uint64_t b = 1;
+            for (int i = 0; i < k; i++) {
+                std::uint64_t length = factors[i].length;
+                sum += length;
+                forward = forward * HASH_BASE + length;
+                backward += length * b;
+                b *= HASH_BASE;
+            }
+
+            longest.clear();
+            head = 0;
+            for (int i = trim; i < k - trim; i++) {
+                push_longest(i);
+            }
+        }
+
+        void next() {
+            int out = (*factors)[begin].length, in = (*factors)[begin + k].length;
+            sum += in - out;
+            forward = (forward - (std::uint64_t) out * power) * HASH_BASE + in;
+            backward = (backward - out) * inverse_base + (std::uint64_t) in * power;
+
+            begin++;
+            if (longest[head] < begin + trim) {
+                head++;
+            }
+            push_longest(begin + k - 1 - trim);
+        }
+
+        // Key of the window
+        void key(Lyndon::NodeKey &key, bool normalize, bool enriched) {
+            const auto &f = *factors;
+            bool reverse = false;
+            if (normalize) {
+                for (int left = begin, right = begin + k - 1; left < right; left++, right--) {
+                    if (f[left].length != f[right].length) {
+                        reverse = f[left].length > f[right].length;
+                        break;
+                    }
+                }
             }
 
-            Node* nL = add_node(
-                    kfL, key_seqL, read_id, offset, join(factors, "", idx, idx + k)
-            );
-            Node* nR = add_node(
-                    kfR, key_seqR, read_id, offset + kfL[0], join(factors, "", idx + 1, idx + k + 1)
-            );
+            key.k = k;
+            for (int i = 0; i < k; i++) {
+                key.kf[i] = f[reverse ? begin + k - 1 - i : begin + i].length;
+            }
+            if (enriched) {
+                Lyndon::get_key_factor(f[longest[head]], normalize, key_seq);
+            } else {
+                key_seq.clear();
+            }
+            key.set_key_sequence(key_seq.data(), key_seq.length());
+            if (normalize) {
+                // The key factor is normalized once more after it has been cut
+                key.normalize_key_sequence();
+            }
+            key.hash = Lyndon::hash_key(reverse ? backward : forward, key);
+        }
+
+    private:
+        const Lyndon::factor_spans *factors;
+        int k, trim;
+        std::uint64_t power, inverse_base, forward, backward;
+        std::vector<int> longest;
+        std::size_t head;
+        std::string key_seq;
+
+        // Ties go to the leftmost factor, as in get_key_factor
+        void push_longest(int i) {
+            const auto &f = *factors;
+            while (longest.size() > head && f[longest.back()].length < f[i].length) {
+                longest.pop_back();
+            }
+            longest.push_back(i);
+        }
+    };
+}
+
+namespace {
+    // Walks the windows of a read, calling visit(keyL, offsetL, keyR, offsetR, chained)
+    // on every pair of consecutive windows whose sums both reach `limit`, where
+    // `chained` is true if keyL was the right key of the previous call.
+    template <class Visit> void for_each_pair(const Lyndon::factor_spans &factors, int offset, int k, int limit,
+                                              bool normalize, bool enriched, Visit visit) {
+        // Scratch buffers, reused by all the reads walked by a thread
+        thread_local KFingerWindow window;
+        thread_local Lyndon::NodeKey keys[2];
+
+        window.reset(factors, k);
+        int current = 0;
+        window.key(keys[current], normalize, enriched);
+
+        bool chained = false;
+        while ((std::size_t) (window.begin + k) < factors.size()) {
+            int sumL = window.sum, lengthL = factors[window.begin].length;
+            window.next();
+            window.key(keys[1 - current], normalize, enriched);
+
+            if (sumL < limit || window.sum < limit) {
+                chained = false;
+            } else {
+                visit(keys[current], offset, keys[1 - current], offset + lengthL, chained);
+                chained = true;
+            }
+
+            offset += lengthL;
+            current = 1 - current;
+        }
+    }
+}
+
+void Lyndon::FingerGraph::add_read(const Lyndon::read_id &read_id, int offset, const Lyndon::factor_spans &factors) {
+    if (factors.size() <= (std::size_t) k) {
+        return;
+    }
+
+    auto r_id = this->reads.intern(read_id.data(), read_id.length());
+    // With a two-pass build, the nodes counted less than twice are left out
+    auto add_solid_node = [this, r_id](const Lyndon::NodeKey &key, int offset) -> Node* {
+        if (this->counts != nullptr && this->counts->count(key.hash) < 2) {
+            return nullptr;
+        }
+        return add_node(key, r_id, offset);
+    };
+
+    Node* nL = nullptr;
+    for_each_pair(factors, offset, k, limit, this->is_normalized, enriched_kfingers,
+                  [&](const Lyndon::NodeKey &keyL, int offsetL, const Lyndon::NodeKey &keyR, int offsetR, bool chained) {
+        if (!chained) {
+            nL = add_solid_node(keyL, offsetL);
+        }
+        Node* nR = add_solid_node(keyR, offsetR);
+        if (nL != nullptr && nR != nullptr) {
             add_edge(nL, nR);
+        }
+        nL = nR;
+    });
+}
+
+void Lyndon::FingerGraph::count_read(const Lyndon::factor_spans &factors) {
+    if (factors.size() <= (std::size_t) k) {
+        return;
+    }
 
-            offset += fp[idx];
-            idx++;
+    auto &counts = *this->counts;
+    for_each_pair(factors, 0, k, limit, this->is_normalized, enriched_kfingers,
+                  [&counts](const Lyndon::NodeKey &keyL, int, const Lyndon::NodeKey &keyR, int, bool chained) {
+        if (!chained) {
+            counts.add(keyL.hash);
         }
+        counts.add(keyR.hash);
+    });
+}
+
+void Lyndon::FingerGraph::enable_two_pass(int log2_counters) {
+    this->counts.reset(new CountingFilter(log2_counters));
+}
 
+std::size_t Lyndon::FingerGraph::size() const {
+    std::size_t result = 0;
+    for (const auto &shard : this->shards) {
+        result += shard.nodes.size();
     }
+    return result;
 }
 
-Lyndon::FingerGraph::FingerGraph() : k(0), limit(0), is_normalized(false), is_directed(true) { }
+Lyndon::NodeShard &Lyndon::FingerGraph::shard_of(const Lyndon::NodeKey &key) {
+    return this->shards[KeyHasher()(key) % this->shards.size()];
+}
 
-Lyndon::Node* Lyndon::FingerGraph::add_node(const Lyndon::k_finger &kf, const std::string &key_seq,
-                                   const std::string &read_id, int offset, const std::string &seq) {
-    auto key = make_key(kf, key_seq);
-    if (this->nodes.find(key) == this->nodes.end()) {
-        Node* n = make_node(kf, key_seq, read_id, offset, seq);
-        this->nodes[key] = n;
-        return n;
-    } else {
-        auto occ = Lyndon::Occurrence { read_id, offset };
-        this->nodes[key]->occs.insert(occ);
-        return this->nodes[key];
+Lyndon::Node* Lyndon::FingerGraph::add_node(const Lyndon::NodeKey &key, std::uint32_t r_id, int offset) {
+    auto &shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    Node* n = shard.nodes.find(key);
+    if (n == nullptr) {
+        n = make_node(shard, key);
     }
+    shard.occurrence_log.emplace_back(n, Lyndon::Occurrence { r_id, offset });
+    return n;
+}
+
+Lyndon::Node* Lyndon::FingerGraph::get_node(const Lyndon::NodeKey &key) {
+    auto &shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    Node* n = shard.nodes.find(key);
+    if (n == nullptr) {
+        n = make_node(shard, key);
+    }
+    return n;
 }
 
 void Lyndon::FingerGraph::add_edge(Lyndon::Node* n1, Lyndon::Node* n2) {
-    n1->adj_list.insert(n2);
+    add_arc(n1, n2);
     if (!this->is_directed) {
-        n2->adj_list.insert(n1);
+        add_arc(n2, n1);
     }
 }
 
-Lyndon::NodeKey Lyndon::FingerGraph::make_key(const Lyndon::k_finger &kf, const std::string &key_seq) const {
-    if (this->is_normalized) {
-        return Lyndon::NodeKey { normalize(kf), normalize(key_seq) };
+void Lyndon::FingerGraph::add_arc(Lyndon::Node* n1, Lyndon::Node* n2) {
+    auto &shard = shard_of(n1->key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.edge_log.emplace_back(n1, n2);
+}
+
+void Lyndon::FingerGraph::freeze(int threads) {
+    this->counts.reset();
+    // Occurrences are sorted by read index, so the reads are numbered by name first
+    auto rank = this->reads.sort_by_name();
+    parallel_for(threads, this->shards.size(), [this, &rank](std::size_t i) {
+        for (auto &entry : this->shards[i].occurrence_log) {
+            entry.second.r_id = rank[entry.second.r_id];
+        }
+        this->shards[i].freeze();
+    });
+}
+
+namespace {
+    // Sorts (by `less`) and dedups a log of (node, value) pairs, moves the values to
+    // `values` and points the `member` range of every node to its run of values.
+    template <class T, class Less> void freeze_log(std::vector<std::pair<Lyndon::Node*, T>> &log, std::vector<T> &values,
+                                                   Lyndon::Range<T> Lyndon::Node::*member, Less less) {
+        std::sort(log.begin(), log.end(), [&less](const std::pair<Lyndon::Node*, T> &x, const std::pair<Lyndon::Node*, T> &y) {
+            if (x.first != y.first) {
+                return std::less<Lyndon::Node*>()(x.first, y.first);
+            }
+            return less(x.second, y.second);
+        });
+        log.erase(std::unique(log.begin(), log.end()), log.end());
+
+        values.resize(log.size());
+        for (std::size_t i = 0; i < log.size(); i++) {
+            values[i] = log[i].second;
+        }
+        for (std::size_t begin = 0, end; begin < log.size(); begin = end) {
+            Lyndon::Node* n = log[begin].first;
+            for (end = begin + 1; end < log.size() && log[end].first == n; end++) { }
+            n->*member = Lyndon::Range<T> { values.data() + begin, (std::uint32_t) (end - begin) };
+        }
+
+        std::vector<std::pair<Lyndon::Node*, T>>().swap(log);
     }
-    return Lyndon::NodeKey { kf, key_seq };
 }
 
-Lyndon::Node* Lyndon::FingerGraph::make_node(const Lyndon::k_finger &kf, const std::string &key_seq,
-                                             std::set<Lyndon::Occurrence> &occs) const {
-    return new Lyndon::Node {
-        make_key(kf, key_seq),
-        occs,
-        std::set<Node*>()
-    };
+void Lyndon::NodeShard::freeze() {
+    freeze_log(this->occurrence_log, this->occurrences, &Lyndon::Node::occs, std::less<Lyndon::Occurrence>());
+    freeze_log(this->edge_log, this->edges, &Lyndon::Node::adj_list, [](const Lyndon::Node* x, const Lyndon::Node* y) {
+        return *x < *y;
+    });
+
+    this->sorted_nodes.clear();
+    this->sorted_nodes.reserve(this->nodes.size());
+    for (Node* n : this->nodes.slots()) {
+        if (n != nullptr) {
+            this->sorted_nodes.push_back(n);
+        }
+    }
+    std::sort(this->sorted_nodes.begin(), this->sorted_nodes.end(), [](const Lyndon::Node* x, const Lyndon::Node* y) {
+        return *x < *y;
+    });
 }
 
-Lyndon::Node* Lyndon::FingerGraph::make_node(const Lyndon::k_finger &kf, const std::string &key_seq,
-                                             const std::string &read_id, int offset, const std::string &seq) const {
+Lyndon::Node* Lyndon::FingerGraph::make_node(Lyndon::NodeShard &shard, const Lyndon::NodeKey &key) const {
+    Node* n = shard.node_arena.make(
+        key,
+        Lyndon::Range<Lyndon::Occurrence> { nullptr, 0 },
+        Lyndon::Range<Node*> { nullptr, 0 }
+    );
+    shard.nodes.insert(n);
+    return n;
+}
 
-    auto node = new Lyndon::Node {
-            make_key(kf, key_seq),
-            std::set<Lyndon::Occurrence>(),
-            std::set<Node*>()
-    };
-    auto occ = Lyndon::Occurrence { read_id, offset };
-    node->occs.insert(occ);
+Lyndon::Node* Lyndon::NodeTable::find(const Lyndon::NodeKey &key) const {
+    if (this->table.empty()) {
+        return nullptr;
+    }
+    std::size_t mask = this->table.size() - 1;
+    for (std::size_t i = slot_of(key.hash); this->table[i] != nullptr; i = (i + 1) & mask) {
+        if (this->table[i]->key == key) {
+            return this->table[i];
+        }
+    }
+    return nullptr;
+}
+
+void Lyndon::NodeTable::insert(Lyndon::Node* n) {
+    // At most half of the slots are used
+    if (2 * (this->count + 1) > this->table.size()) {
+        grow();
+    }
+    std::size_t mask = this->table.size() - 1;
+    std::size_t i = slot_of(n->key.hash);
+    while (this->table[i] != nullptr) {
+        i = (i + 1) & mask;
+    }
+    this->table[i] = n;
+    this->count++;
+}
+
+std::size_t Lyndon::NodeTable::slot_of(std::uint64_t hash) const {
+    // The low bits of the hashes in a shard are all the same, the multiplication
+    // moves all of them into the high bits
+    return (std::size_t) ((hash * 0x9E3779B97F4A7C15ULL) >> (64 - this->log2_size));
+}
+
+void Lyndon::NodeTable::grow() {
+    this->log2_size = this->table.empty() ? 4 : this->log2_size + 1;
+    std::vector<Node*> old(std::size_t(1) << this->log2_size, nullptr);
+    old.swap(this->table);
+    this->count = 0;
+    for (Node* n : old) {
+        if (n != nullptr) {
+            insert(n);
+        }
+    }
+}
+
+std::uint64_t Lyndon::hash_kfinger(const Lyndon::k_finger &kf) {
+    std::uint64_t result = 0;
+    for (auto length : kf) {
+        result = result * HASH_BASE + (std::uint64_t) length;
+    }
+    return result;
+}
 
-    return node;
+std::size_t Lyndon::hash_key(std::uint64_t kf_hash, const Lyndon::NodeKey &key) {
+    std::uint64_t h = kf_hash ^ (key.key_bases * 0x9e3779b97f4a7c15ULL)
+        ^ ((key.key_n_mask | (std::uint64_t) key.key_length << 32) * 0xc2b2ae3d27d4eb4fULL);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
 }
 
 std::string Lyndon::get_key_factor(const Lyndon::factorization &factors, int begin, int end, bool normalize) {
+    auto spans = Lyndon::factor_spans(factors.size());
+    for (int i = 0; i < spans.size(); i++) {
+        spans[i] = Lyndon::FactorSpan { factors[i].data(), (int) factors[i].length() };
+    }
+    return get_key_factor(spans, begin, end, normalize);
+}
+
+std::string Lyndon::get_key_factor(const Lyndon::factor_spans &factors, int begin, int end, bool normalize) {
     if (end - begin > 3) {
         begin += 1;
         end -= 1;
     }
 
     int idx = begin;
-    int max_idx = idx, max_length = factors[idx].length();
+    int max_idx = idx, max_length = factors[idx].length;
     while (idx < end) {
-        if (factors[idx].length() > max_length) {
+        if (factors[idx].length > max_length) {
             max_idx = idx;
-            max_length = factors[idx].length();
+            max_length = factors[idx].length;
         }
 
         idx++;
     }
 
-    auto longest = factors[max_idx];
-    if (normalize) {
-        auto rev_comp = reverse_complement(longest);
-        if (rev_comp < longest) {
-            longest = rev_comp;
-        }
-    }
+    std::string result;
+    get_key_factor(factors[max_idx], normalize, result);
+    return result;
+}
 
-    if (longest.length() > 20) {
-        longest = longest.substr(0, 10) + longest.substr(longest.length() - 10, 10);
+// Key factor of a window whose longest factor is `longest`: the factor (or its
+// reverse complement, if smaller and normalizing) cut down to its first and last
+// 10 bases. The strand is chosen without building the reverse complement.
+void Lyndon::get_key_factor(const Lyndon::FactorSpan &longest, bool normalize, std::string &key_seq) {
+    const char *s = longest.begin;
+    int n = longest.length;
+
+    bool reverse = normalize && compare_reverse_complement(s, n) > 0;
+
+    key_seq.clear();
+    auto append = [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            key_seq.push_back(reverse ? complement(s[n - 1 - i]) : s[i]);
+        }
+    };
+    if (n > 20) {
+        append(0, 10);
+        append(n - 10, n);
+    } else {
+        append(0, n);
     }
-    return longest;
 }
 
 Lyndon::k_finger Lyndon::normalize(const Lyndon::k_finger &kf) {
@@ -155,23 +503,9 @@ Lyndon::k_finger Lyndon::normalize(const Lyndon::k_finger &kf) {
 }
 
 std::string Lyndon::normalize(const std::string &seq) {
-    if (seq.length() == 0) {
-        return seq;
+    if (compare_reverse_complement(seq.data(), seq.length()) > 0) {
+        return reverse_complement(seq);
     }
-
-    int left = 0, right = seq.length() - 1;
-    while (left < right) {
-        if (seq[left] < complement(seq[right])) {
-            return seq;
-        }
-        if (seq[left] > complement(seq[right])) {
-            return reverse_complement(seq);
-        }
-
-        left++;
-        right--;
-    }
-
     return seq;
 }
 
@@ -186,24 +520,71 @@ bool Lyndon::operator==(const Lyndon::Occurrence &x, const Lyndon::Occurrence &y
     return x.r_id == y.r_id && x.offset == y.offset;
 }
 
-std::ostream &operator<<(std::ostream &out, Lyndon::Occurrence o) {
-    out << o.to_string();
-    return out;
+std::string Lyndon::Occurrence::to_string(const Lyndon::ReadTable &reads) const {
+    return "('" + reads[this->r_id] + "', " + std::to_string(this->offset) + ")";
 }
 
-std::string Lyndon::Occurrence::to_string() const {
-    return "('" + this->r_id + "', " + std::to_string(this->offset) + ")";
+Lyndon::ReadTable::ReadTable() : offsets(1, 0), index(0, NameHasher { this }, NameEqual { this }) { }
+
+std::uint32_t Lyndon::ReadTable::intern(const char *name, int length) {
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    // The name is appended as a candidate entry, then dropped if it was already known
+    auto r_id = (std::uint32_t) size();
+    this->pool.insert(this->pool.end(), name, name + length);
+    this->offsets.push_back(this->pool.size());
+
+    auto it = this->index.find(r_id);
+    if (it != this->index.end()) {
+        this->pool.resize(this->offsets[r_id]);
+        this->offsets.pop_back();
+        return *it;
+    }
+    this->index.insert(r_id);
+    return r_id;
 }
 
-bool Lyndon::operator<(const Lyndon::NodeKey &x, const Lyndon::NodeKey &y) {
-    if (x.kf == y.kf) {
-        return x.key_sequence < y.key_sequence;
+std::vector<std::uint32_t> Lyndon::ReadTable::sort_by_name() {
+    std::vector<std::uint32_t> order(size());
+    for (std::uint32_t r = 0; r < order.size(); r++) {
+        order[r] = r;
+    }
+    std::sort(order.begin(), order.end(), [this](std::uint32_t x, std::uint32_t y) {
+        int c = memcmp(name(x), name(y), std::min(length(x), length(y)));
+        return c != 0 ? c < 0 : length(x) < length(y);
+    });
+
+    std::vector<std::uint32_t> rank(order.size());
+    std::vector<char> sorted_pool;
+    std::vector<std::uint64_t> sorted_offsets(1, 0);
+    sorted_pool.reserve(this->pool.size());
+    sorted_offsets.reserve(this->offsets.size());
+    for (std::uint32_t i = 0; i < order.size(); i++) {
+        rank[order[i]] = i;
+        sorted_pool.insert(sorted_pool.end(), name(order[i]), name(order[i]) + length(order[i]));
+        sorted_offsets.push_back(sorted_pool.size());
+    }
+    this->pool.swap(sorted_pool);
+    this->offsets.swap(sorted_offsets);
+
+    this->index.clear();
+    for (std::uint32_t r = 0; r < order.size(); r++) {
+        this->index.insert(r);
     }
-    return x.kf < y.kf;
+    return rank;
 }
 
-bool Lyndon::operator==(const Lyndon::NodeKey &x, const Lyndon::NodeKey &y) {
-    return x.kf == y.kf && x.key_sequence == y.key_sequence;
+std::size_t Lyndon::ReadTable::NameHasher::operator()(std::uint32_t r_id) const {
+    std::size_t h = 0xcbf29ce484222325ULL;
+    const char *name = table->name(r_id);
+    for (int i = 0; i < table->length(r_id); i++) {
+        h = (h ^ (unsigned char) name[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+bool Lyndon::ReadTable::NameEqual::operator()(std::uint32_t x, std::uint32_t y) const {
+    return table->length(x) == table->length(y) && memcmp(table->name(x), table->name(y), table->length(x)) == 0;
 }
 
 bool Lyndon::operator<(const Lyndon::Node &x, const Lyndon::Node &y) {
@@ -214,95 +595,305 @@ bool Lyndon::operator==(const Lyndon::Node &x, const Lyndon::Node &y) {
     return x.key == y.key;
 }
 
-Lyndon::FingerGraph* Lyndon::FingerGraph::from_graph_file(const std::string &file_path) {
-    //    TODO: implement
-    auto* graph = new Lyndon::FingerGraph();
+namespace {
+    bool to_node_key(const GraphLineKey &line_key, int k, Lyndon::NodeKey &key) {
+        if (line_key.kf.size() != (std::size_t) k || line_key.key_length > Lyndon::NodeKey::MAX_KEY_LENGTH) {
+            return false;
+        }
+        key.set_kfinger(line_key.kf, k);
+        key.set_key_sequence(line_key.key_seq, line_key.key_length);
+        key.hash = Lyndon::hash_key(Lyndon::hash_kfinger(line_key.kf), key);
+        return true;
+    }
+}
+
+Lyndon::FingerGraph* Lyndon::FingerGraph::from_graph_file(const std::string &file_path, int threads) {
+    if (GraphFile::is_graph_file(file_path)) {
+        return from_binary_file(file_path, threads);
+    }
 
     igzstream in(file_path.c_str());
-    std::string line;
+    if (!in.rdbuf()->is_open()) {
+        return nullptr;
+    }
 
+    // Header: HT followed by key=value pairs, as written by save() or by lyndon.py
+    std::string line;
     getline(in, line);
     auto header_v = split(line, '\t');
-    graph->k = std::stoi(header_v[1].substr(2));
-    graph->limit = std::stoi(header_v[3].substr(10));
-    graph->is_normalized = header_v[4].substr(14) == "True";
-    graph->is_directed = !graph->is_normalized;
-
-    while (getline(in, line)) {
-        if (line.find("ED") == 0) break;
-        if (line.find("VT") != 0) {
-            fprintf(stderr, "Error while reading graph. File corrupted.\n");
-            abort();
+    if (header_v.empty() || header_v[0] != "HT") {
+        fprintf(stderr, "Error while reading graph. File corrupted.\n");
+        abort();
+    }
+    int k = 0, limit = 0;
+    bool is_normalized = false, is_enriched = false;
+    for (std::size_t i = 1; i < header_v.size(); i++) {
+        auto eq = header_v[i].find('=');
+        auto name = header_v[i].substr(0, eq), value = trim(header_v[i].erase(0, eq + 1));
+        if (name == "k") {
+            k = std::stoi(value);
+        } else if (name == "threshold" || name == "limit") {
+            limit = std::stoi(value);
+        } else if (name == "is_normalized") {
+            is_normalized = value == "1" || value == "True";
+        } else if (name == "is_enriched") {
+            is_enriched = value == "1" || value == "True";
         }
+    }
+    if (k < 1 || k > NodeKey::MAX_K) {
+        fprintf(stderr, "Cannot load a graph with k = %d (the maximum is %d)\n", k, NodeKey::MAX_K);
+        return nullptr;
+    }
+
+    auto graph = new Lyndon::FingerGraph(k, limit, is_normalized, !is_enriched);
+    auto lines = std::vector<GraphLine>(std::max(threads, 1));
+    std::string rest;
+    process_batches<std::vector<char>>(threads, [&in, &rest](std::vector<char> &chunk) {
+        return read_chunk(in, chunk, rest);
+    }, [&](std::vector<char> &chunk, int t) {
+        auto &graph_line = lines[t];
+        std::vector<std::uint32_t> r_ids;
+        for_each_line(chunk, [&](const char *begin, const char *end) {
+            if (begin == end) {
+                return;
+            }
+
+            Lyndon::NodeKey keys[2];
+            if (!parse_graph_line(begin, end, graph_line) || !to_node_key(graph_line.keys[0], k, keys[0])
+                || (!graph_line.is_vertex && !to_node_key(graph_line.keys[1], k, keys[1]))) {
+                fprintf(stderr, "Error while reading graph. File corrupted.\n");
+                abort();
+            }
 
-        // Parse key
-        auto kf = std::vector<int>();
-        auto key_seq = "";
-        // Parse occs set
-        auto occs = std::set<Lyndon::Occurrence>();
-        // Parse occ
-        Lyndon::Occurrence occ = { };
-        occs.insert(occ);
+            if (!graph_line.is_vertex) {
+                // Undirected graphs list both directions of each edge already
+                graph->add_arc(graph->get_node(keys[0]), graph->get_node(keys[1]));
+                return;
+            }
+
+            r_ids.clear();
+            for (const auto &occ : graph_line.occurrences) {
+                r_ids.push_back(graph->reads.intern(occ.read_id, occ.read_id_length));
+            }
+            auto &shard = graph->shard_of(keys[0]);
+            std::lock_guard<std::mutex> guard(shard.lock);
+            Node* n = shard.nodes.find(keys[0]);
+            if (n == nullptr) {
+                n = graph->make_node(shard, keys[0]);
+            }
+            for (std::size_t i = 0; i < r_ids.size(); i++) {
+                shard.occurrence_log.emplace_back(n, Lyndon::Occurrence { r_ids[i], graph_line.occurrences[i].offset });
+            }
+        });
+    });
+    graph->freeze(threads);
+    return graph;
+}
 
-        auto new_node = graph->make_node(kf, key_seq, occs);
-        graph->nodes[new_node->key] = new_node;
+Lyndon::FingerGraph* Lyndon::FingerGraph::from_binary_file(const std::string &file_path, int threads) {
+    Lyndon::GraphFile file(file_path);
+    if (!file.is_open()) {
+        return nullptr;
+    }
+    const auto &h = file.header();
 
-        std::cout << line << std::endl;
+    auto graph = new Lyndon::FingerGraph(h.k, h.limit, h.is_normalized, h.enriched_kfingers);
+    // Read names are distinct, so they get the same numbers they have in the file
+    for (std::uint32_t r = 0; r < file.read_count(); r++) {
+        graph->reads.intern(file.name(r), file.length(r));
+    }
+    if (graph->reads.size() != file.read_count()) {
+        fprintf(stderr, "%s is truncated or corrupted\n", file_path.c_str());
+        delete graph;
+        return nullptr;
     }
 
+    std::vector<Node*> nodes(file.size());
+    parallel_for(threads, file.size(), [&](std::size_t i) {
+        auto key = file.key(i);
+        auto &shard = graph->shard_of(key);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        Node* n = shard.nodes.find(key);
+        if (n == nullptr) {
+            n = graph->make_node(shard, key);
+        }
+        for (const auto &occ : file.occurrences(i)) {
+            shard.occurrence_log.emplace_back(n, occ);
+        }
+        nodes[i] = n;
+    });
+    parallel_for(threads, file.size(), [&](std::size_t i) {
+        for (auto j : file.neighbours(i)) {
+            graph->add_arc(nodes[i], nodes[j]);
+        }
+    });
+    graph->freeze(threads);
     return graph;
 }
 
-void Lyndon::FingerGraph::save() {
+namespace {
+    // The edges from n1 to each of its neighbours which are printed too, and
+    // their reverse if the graph is undirected
+    void append_edges(std::string &out, const Lyndon::Node &n1, bool directed, std::string &label1, std::string &label2) {
+        label1.clear();
+        append_key(label1, n1.key);
+        for (const Lyndon::Node* n2 : n1.adj_list) {
+            if (n2->occs.size() < 2) {
+                continue;
+            }
+
+            label2.clear();
+            append_key(label2, n2->key);
+            append_edge(out, label1, label2);
+            if (!directed) {
+                append_edge(out, label2, label1);
+            }
+        }
+    }
+}
+
+std::string Lyndon::FingerGraph::header() const {
     std::vector<std::string> htv = { "HT", "k=" + std::to_string(this->k),
         "threshold=" + std::to_string(this->limit), "is_normalized=" + std::to_string(this->is_normalized),
         "is_enriched=" + std::to_string(this->is_enriched) + "\n"};
-    auto ht = join(htv, "\t");
-    printf("%s", ht.c_str());
+    return join(htv, "\t");
+}
 
-    for (const auto &pair : this->nodes) {
-        const Node* n = pair.second;
-        if (n->occs.size() < 2) {
-            continue;
-        }
-        printf("VT\t((%s), '%s')\t%s\n",
-                 v2s(n->key.kf, ", ").c_str(),
-                n->key.key_sequence.c_str(),
-                set2str(n->occs).c_str());
+void Lyndon::FingerGraph::save(std::ostream &out, int threads, bool gzip) const {
+    auto ht = header();
+    if (gzip) {
+        std::string member;
+        gzip_member(ht.data(), ht.length(), member);
+        out.write(member.data(), member.length());
+    } else {
+        out.write(ht.data(), ht.length());
     }
 
-    for (const auto &pair : this->nodes) {
-        const Node* n1 = pair.second;
+    // Shards are formatted (and compressed) in parallel and written in order
+    auto write_all = [&](bool vertices) {
+        write_blocks(out, threads, this->shards.size(), [&](std::size_t shard, std::string &buffer) {
+            std::string label1, label2;
+            for (const Node* n : this->shards[shard].sorted_nodes) {
+                if (n->occs.size() < 2) {
+                    continue;
+                }
+                if (vertices) {
+                    append_vertex(buffer, n->key, n->occs, this->reads);
+                } else {
+                    append_edges(buffer, *n, this->is_directed, label1, label2);
+                }
+            }
+            if (gzip && !buffer.empty()) {
+                std::string member;
+                gzip_member(buffer.data(), buffer.length(), member);
+                buffer.swap(member);
+            }
+        });
+    };
+    write_all(true);
+    write_all(false);
+}
 
-        if (n1->occs.size() < 2) {
-            continue;
-        }
+namespace {
+    // Writes the array v[0, n) padded to a multiple of 8 bytes
+    template <class T> void write_section(std::ostream &out, const T *v, std::size_t n) {
+        static const char padding[8] = { };
+        out.write((const char *) v, n * sizeof(T));
+        out.write(padding, (8 - n * sizeof(T) % 8) % 8);
+    }
 
-        auto kf1_str = v2s(n1->key.kf, ", ");
-        for (const Node* n2 : n1->adj_list) {
-            if (n2->occs.size() < 2) {
-                continue;
-            }
+    std::uint64_t section_size(std::size_t size) {
+        return (size + 7) / 8 * 8;
+    }
+}
 
-            auto kf2_str = v2s(n2->key.kf, ", ");
-            printf("ED\t((%s), '%s')\t((%s), '%s')\n",
-                     kf1_str.c_str(),
-                     n1->key.key_sequence.c_str(),
-                     kf2_str.c_str(),
-                     n2->key.key_sequence.c_str());
-            if (!this->is_directed) {
-                 printf("ED\t((%s), '%s')\t((%s), '%s')\n",
-                     kf2_str.c_str(),
-                     n2->key.key_sequence.c_str(),
-                     kf1_str.c_str(),
-                     n1->key.key_sequence.c_str());
+void Lyndon::FingerGraph::save_binary(std::ostream &out) const {
+    // Nodes are written in the order they are numbered
+    Lyndon::NodeIndex nodes(*this);
+    std::vector<Lyndon::GraphFileKey> keys(nodes.size());
+    std::vector<std::uint32_t> kfingers(nodes.size() * this->k);
+    std::vector<std::uint64_t> occurrence_offsets(1, 0), edge_offsets(1, 0);
+    std::vector<Lyndon::Occurrence> occurrences;
+    std::vector<std::uint32_t> edges;
+    for (std::size_t i = 0; i < nodes.size(); i++) {
+        const Node* n = nodes[i];
+        keys[i] = Lyndon::GraphFileKey { n->key.key_bases, n->key.key_n_mask, n->key.key_length, { } };
+        std::copy(n->key.kf, n->key.kf + this->k, kfingers.begin() + i * this->k);
+
+        occurrences.insert(occurrences.end(), n->occs.begin(), n->occs.end());
+        occurrence_offsets.push_back(occurrences.size());
+
+        // Neighbours keep the key order of freeze(), in which save() prints them
+        for (const Node* n2 : n->adj_list) {
+            auto j = nodes.find(n2);
+            if (j != Lyndon::NodeIndex::NONE) {
+                edges.push_back(j);
             }
         }
+        edge_offsets.push_back(edges.size());
+    }
+
+    std::vector<std::uint64_t> name_offsets(1, 0);
+    for (std::uint32_t r = 0; r < this->reads.size(); r++) {
+        name_offsets.push_back(name_offsets.back() + this->reads.length(r));
+    }
+
+    Lyndon::GraphFileHeader h = { };
+    memcpy(h.magic, "LYNDONFG", 8);
+    h.version = Lyndon::GraphFileHeader::VERSION;
+    h.k = this->k;
+    h.limit = this->limit;
+    h.is_normalized = this->is_normalized;
+    h.is_directed = this->is_directed;
+    h.is_enriched = this->is_enriched;
+    h.enriched_kfingers = this->enriched_kfingers;
+    h.n_nodes = nodes.size();
+    h.n_occurrences = occurrences.size();
+    h.n_edges = edges.size();
+    h.n_reads = this->reads.size();
+    h.names_length = name_offsets.back();
+    h.keys = sizeof(h);
+    h.kfingers = h.keys + section_size(keys.size() * sizeof(Lyndon::GraphFileKey));
+    h.occurrence_offsets = h.kfingers + section_size(kfingers.size() * sizeof(std::uint32_t));
+    h.occurrences = h.occurrence_offsets + section_size(occurrence_offsets.size() * sizeof(std::uint64_t));
+    h.edge_offsets = h.occurrences + section_size(occurrences.size() * sizeof(Lyndon::Occurrence));
+    h.edges = h.edge_offsets + section_size(edge_offsets.size() * sizeof(std::uint64_t));
+    h.name_offsets = h.edges + section_size(edges.size() * sizeof(std::uint32_t));
+    h.names = h.name_offsets + section_size(name_offsets.size() * sizeof(std::uint64_t));
+
+    write_section(out, &h, 1);
+    write_section(out, keys.data(), keys.size());
+    write_section(out, kfingers.data(), kfingers.size());
+    write_section(out, occurrence_offsets.data(), occurrence_offsets.size());
+    write_section(out, occurrences.data(), occurrences.size());
+    write_section(out, edge_offsets.data(), edge_offsets.size());
+    write_section(out, edges.data(), edges.size());
+    write_section(out, name_offsets.data(), name_offsets.size());
+    for (std::uint32_t r = 0; r < this->reads.size(); r++) {
+        out.write(this->reads.name(r), this->reads.length(r));
     }
 }
 
-Lyndon::FingerGraph::~FingerGraph() {
-    for (auto &pair : this->nodes) {
-        delete pair.second;
+Lyndon::NodeIndex::NodeIndex(const Lyndon::FingerGraph &graph) {
+    for (const auto &shard : graph.shards) for (const Node* n : shard.sorted_nodes) {
+        if (n->occs.size() >= 2) {
+            this->nodes.push_back(n);
+        }
     }
+    this->sorted.resize(this->nodes.size());
+    for (std::size_t i = 0; i < this->nodes.size(); i++) {
+        this->sorted[i] = std::make_pair(this->nodes[i], (std::uint32_t) i);
+    }
+    std::sort(this->sorted.begin(), this->sorted.end());
 }
+
+std::uint32_t Lyndon::NodeIndex::find(const Lyndon::Node* n) const {
+    auto it = std::lower_bound(this->sorted.begin(), this->sorted.end(), std::make_pair(n, (std::uint32_t) 0));
+    if (it == this->sorted.end() || it->first != n) {
+        return NONE;
+    }
+    return it->second;
+}
+
+// Nodes are released with the arenas of the shards, a slab at a time
+Lyndon::FingerGraph::~FingerGraph() { }
@@ -2,12 +2,19 @@
 #define LYNDONHASH_H
 
 #include <unordered_map>
+#include <unordered_set>
 #include <set>
 #include <utility>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <cstdint>
+#include <algorithm>
 
 
 namespace Lyndon {
@@ -16,54 +23,293 @@ namespace Lyndon {
     typedef std::vector<std::string> factorization;
     typedef std::string read_id;
 
+    // A factor of a read, pointing into a buffer owned by the caller
+    struct FactorSpan {
+        const char *begin;
+        int length;
+    };
+    typedef std::vector<FactorSpan> factor_spans;
+
+    // Read names, interned once: occurrences refer to reads by their index
+    // here, and names are only looked up when the graph is written.
+    class ReadTable {
+    public:
+        ReadTable();
+
+        // Thread-safe. Returns the index of the read called name[0, length)
+        std::uint32_t intern(const char *name, int length);
+        std::size_t size() const { return offsets.size() - 1; }
+        const char *name(std::uint32_t r_id) const { return pool.data() + offsets[r_id]; }
+        int length(std::uint32_t r_id) const { return offsets[r_id + 1] - offsets[r_id]; }
+        read_id operator[](std::uint32_t r_id) const { return read_id(name(r_id), length(r_id)); }
+        // Renumbers the reads in the order of their names, which does not depend on
+        // the order threads interned them in; returns the new index of every read.
+        std::vector<std::uint32_t> sort_by_name();
+
+    private:
+        struct NameHasher {
+            const ReadTable *table;
+            std::size_t operator()(std::uint32_t r_id) const;
+        };
+        struct NameEqual {
+            const ReadTable *table;
+            bool operator()(std::uint32_t x, std::uint32_t y) const;
+        };
+
+        std::vector<char> pool;
+        std::vector<std::uint64_t> offsets;
+        std::unordered_set<std::uint32_t, NameHasher, NameEqual> index;
+        std::mutex lock;
+    };
+
     struct Occurrence {
-        read_id r_id;
-        int offset;
+        std::uint32_t r_id;
+        std::int32_t offset;
 
-        std::string to_string() const;
+        std::string to_string(const ReadTable &reads) const;
     };
     bool operator<(const Occurrence &x, const Occurrence &y);
     bool operator==(const Occurrence &x, const Occurrence &y);
-    std::ostream &operator<<(std::ostream &out, Occurrence o);
 
-    struct NodeKey {
-        k_finger kf;
-        std::string key_sequence;
+    // Base codes of the packed key factors: ACGT in 2 bits, in alphabetical
+    // order, N in a separate mask. Lower case bases are folded to upper case,
+    // other IUPAC codes to N.
+    inline int base_code(char c) {
+        switch (c) {
+            case 'A': case 'a': return 0;
+            case 'C': case 'c': return 1;
+            case 'G': case 'g': return 2;
+            case 'T': case 't': return 3;
+            default: return -1;
+        }
+    }
+
+    // Key of a node packed in a fixed-size value, so the node table holds no
+    // pointers: the k-finger (k <= MaxK) and the key factor, which has at most
+    // 20 bases, packed 2 bits per base with the first base in the highest bits.
+    // `hash` is a function of the rest of the key (see hash_key), cached so that
+    // it can be rolled along the read instead of recomputed per window.
+    template <int MaxK> struct PackedNodeKey {
+        static const int MAX_K = MaxK;
+        static const int MAX_KEY_LENGTH = 20;
+
+        std::uint64_t hash;
+        std::uint64_t key_bases;
+        std::uint32_t key_n_mask;
+        std::uint8_t k;
+        std::uint8_t key_length;
+        std::uint32_t kf[MaxK];
+
+        template <class Lengths> void set_kfinger(const Lengths &lengths, int size) {
+            k = size;
+            for (int i = 0; i < size; i++) {
+                kf[i] = lengths[i];
+            }
+        }
+
+        void set_key_sequence(const char *seq, int length) {
+            key_length = length;
+            key_bases = 0;
+            key_n_mask = 0;
+            for (int i = 0; i < length; i++) {
+                int code = base_code(seq[i]);
+                if (code < 0) {
+                    key_n_mask |= 1u << i;
+                    code = 0;
+                }
+                key_bases = (key_bases << 2) | code;
+            }
+        }
+
+        // Replaces the key factor with its reverse complement if that is smaller.
+        // Without Ns, both are compared as the integers of their codes.
+        void normalize_key_sequence() {
+            std::uint64_t reverse = 0;
+            std::uint32_t reverse_n_mask = 0;
+            for (int i = 0; i < key_length; i++) {
+                // Base i of the reverse complement is the complement of base key_length - 1 - i
+                std::uint32_t n = (key_n_mask >> (key_length - 1 - i)) & 1;
+                reverse = (reverse << 2) | (n ? 0 : 3 - ((key_bases >> (2 * i)) & 3));
+                reverse_n_mask |= n << i;
+            }
+            if (key_n_mask != 0) {
+                // 'N' sorts between 'G' and 'T'
+                for (int i = 0; i < key_length; i++) {
+                    char c = key_base(i);
+                    char d = (reverse_n_mask >> i) & 1 ? 'N' : "ACGT"[(reverse >> (2 * (key_length - 1 - i))) & 3];
+                    if (c != d) {
+                        if (d < c) {
+                            key_bases = reverse;
+                            key_n_mask = reverse_n_mask;
+                        }
+                        return;
+                    }
+                }
+            } else if (reverse < key_bases) {
+                key_bases = reverse;
+            }
+        }
+
+        char key_base(int i) const {
+            if (key_n_mask & (1u << i)) {
+                return 'N';
+            }
+            return "ACGT"[(key_bases >> (2 * (key_length - 1 - i))) & 3];
+        }
+
+        std::string key_sequence() const {
+            std::string result(key_length, 'N');
+            for (int i = 0; i < key_length; i++) {
+                result[i] = key_base(i);
+            }
+            return result;
+        }
+
+        k_finger kfinger() const {
+            return k_finger(kf, kf + k);
+        }
     };
-    bool operator<(const NodeKey &x, const NodeKey &y);
-    bool operator==(const NodeKey &x, const NodeKey &y);
+
+    template <int MaxK> bool operator==(const PackedNodeKey<MaxK> &x, const PackedNodeKey<MaxK> &y) {
+        if (x.hash != y.hash || x.k != y.k || x.key_bases != y.key_bases || x.key_n_mask != y.key_n_mask
+            || x.key_length != y.key_length) {
+            return false;
+        }
+        for (int i = 0; i < x.k; i++) {
+            if (x.kf[i] != y.kf[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <int MaxK> bool operator<(const PackedNodeKey<MaxK> &x, const PackedNodeKey<MaxK> &y) {
+        if (std::lexicographical_compare(x.kf, x.kf + x.k, y.kf, y.kf + y.k)) {
+            return true;
+        }
+        if (std::lexicographical_compare(y.kf, y.kf + y.k, x.kf, x.kf + x.k)) {
+            return false;
+        }
+        int length = std::min(x.key_length, y.key_length);
+        for (int i = 0; i < length; i++) {
+            char a = x.key_base(i), b = y.key_base(i);
+            if (a != b) {
+                return a < b;
+            }
+        }
+        return x.key_length < y.key_length;
+    }
+
+#ifndef LYNDON_MAX_K
+#define LYNDON_MAX_K 8
+#endif
+    typedef PackedNodeKey<LYNDON_MAX_K> NodeKey;
 
     struct KeyHasher
     {
         std::size_t operator()(const NodeKey& k) const
         {
-            using std::size_t;
-            using std::hash;
-            using std::string;
-
-            // Compute individual hash values for first,
-            // second and third and combine them using XOR
-            // and bit shifting:
-            auto result = hash<string>()(k.key_sequence);
-            for (auto i : k.kf) {
-                result ^= hash<int>()(i);
+            return k.hash;
+        }
+    };
+
+    // Polynomial hash of a k-finger, sum of kf[i] * B^(k - 1 - i)
+    std::uint64_t hash_kfinger(const k_finger &kf);
+    std::size_t hash_key(std::uint64_t kf_hash, const NodeKey &key);
+
+    // Contiguous, read-only run of elements stored elsewhere
+    template <class T> struct Range {
+        const T *first;
+        std::uint32_t count;
+
+        const T *begin() const { return first; }
+        const T *end() const { return first + count; }
+        std::size_t size() const { return count; }
+        const T &operator[](std::size_t i) const { return first[i]; }
+    };
+
+    // Bump allocator: objects are carved out of slabs of SLAB_SIZE elements and
+    // are only released all together when the arena is destroyed, so T must not
+    // need its destructor to run.
+    template <class T> class Arena {
+    public:
+        static const std::size_t SLAB_SIZE = 4096;
+
+        template <class... Args> T* make(Args&&... args) {
+            if (this->used == SLAB_SIZE || this->slabs.empty()) {
+                this->slabs.emplace_back(new Slot[SLAB_SIZE]);
+                this->used = 0;
             }
-            return result;
+            return new (&this->slabs.back()[this->used++]) T { std::forward<Args>(args)... };
         }
+
+    private:
+        static_assert(std::is_trivially_destructible<T>::value, "Arena elements are never destroyed");
+        typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+        std::vector<std::unique_ptr<Slot[]>> slabs;
+        std::size_t used = 0;
     };
 
+    // Occurrences and neighbours of a node are runs of sorted, distinct values
+    // in the arrays of its shard; they are only set by FingerGraph::freeze.
     struct Node {
         NodeKey key;
-        std::set<Occurrence> occs;
-        std::set<Node*> adj_list;
+        Range<Occurrence> occs;
+        Range<Node*> adj_list;
     };
     bool operator<(const Node &x, const Node &y);
     bool operator==(const Node &x, const Node &y);
 
+    // Open-addressing hash set of nodes keyed on their key, with linear probing.
+    // Nodes live in the arena of their shard, the table only points to them.
+    class NodeTable {
+    public:
+        std::size_t size() const { return count; }
+        // Slots of the table, empty ones are null
+        const std::vector<Node*> &slots() const { return table; }
+
+        Node* find(const NodeKey &key) const;
+        // `n` must not be in the table yet
+        void insert(Node* n);
+
+    private:
+        std::vector<Node*> table;
+        std::size_t count = 0;
+        int log2_size = 0;
+
+        std::size_t slot_of(std::uint64_t hash) const;
+        void grow();
+    };
+
+    // Nodes are spread by hash over independent tables, so that threads adding
+    // reads only contend on the shard they are touching. While the graph is
+    // built, occurrences and edges leaving the nodes of a shard are appended,
+    // under the lock of the shard, to its logs; freezing the graph sorts and
+    // dedups the logs into the flat arrays the nodes point into. Freezing also
+    // lists the nodes, and sorts the neighbours of each one, by key, so that the
+    // graph is written in the same order whatever the order the reads were added in.
+    struct NodeShard {
+        std::mutex lock;
+        NodeTable nodes; // (kf, seq) -> Node
+        std::vector<Node*> sorted_nodes;
+        Arena<Node> node_arena;
+
+        std::vector<std::pair<Node*, Occurrence>> occurrence_log;
+        std::vector<std::pair<Node*, Node*>> edge_log;
+        std::vector<Occurrence> occurrences;
+        std::vector<Node*> edges;
+
+        void freeze();
+    };
+
+    class CountingFilter;
+
     class FingerGraph {
     public:
         FingerGraph();
-        FingerGraph(std::istream &factors, int k, int limit, bool normalize, bool enriched_kfingers);
+        FingerGraph(int k, int limit, bool normalize, bool enriched_kfingers);
+        FingerGraph(std::istream &factors, int k, int limit, bool normalize, bool enriched_kfingers, int threads = 1);
         ~FingerGraph();
 
         int k;
@@ -71,22 +317,76 @@ namespace Lyndon {
         bool is_normalized;
         bool is_directed;
         bool is_enriched;
+        bool enriched_kfingers;
 
-        std::unordered_map<NodeKey, Node*, KeyHasher> nodes; // (kf, seq) -> Node
+        std::vector<NodeShard> shards;
+        ReadTable reads;
 
-        void save();
-        static FingerGraph* from_graph_file(const std::string &file_path);
+        std::size_t size() const;
+        // Thread-safe. Reads can only be added before the graph is frozen
+        void add_read(const read_id &r_id, int offset, const factor_spans &factors);
+        void add_reads(std::istream &factors, int threads = 1);
+        // Two-pass build: after enable_two_pass(), every read is first passed to
+        // count_read() (thread-safe) and add_read() then only adds the nodes
+        // counted at least twice, i.e. all the nodes save() can print and a few
+        // more due to the collisions of the counting filter.
+        void enable_two_pass(int log2_counters);
+        void count_read(const factor_spans &factors);
+        void count_reads(std::istream &factors, int threads = 1);
+        // Makes the occurrences and the edges added so far available in the nodes
+        void freeze(int threads = 1);
+        // Writes the graph as text; with more threads, the lines of different
+        // shards are formatted in parallel and written in the same order. With
+        // `gzip`, every block of lines is written as a separate gzip member.
+        void save(std::ostream &out = std::cout, int threads = 1, bool gzip = false) const;
+        // The HT line save() starts with
+        std::string header() const;
+        // Writes the graph in the binary format read by GraphFile
+        void save_binary(std::ostream &out) const;
+        // Loads a graph written by save(), plain or gzipped, or by save_binary();
+        // returns nullptr if the file cannot be read
+        static FingerGraph* from_graph_file(const std::string &file_path, int threads = 1);
 
     private:
-        NodeKey make_key(const k_finger &kf, const std::string &key_seq) const;
-        Node* make_node(const k_finger &kf, const std::string &key_seq, std::set<Occurrence> &occs) const;
-        Node* make_node(const k_finger &kf, const std::string &key_seq, const std::string &read_id, int offset, const std::string &seq) const;
+        static const int N_SHARDS = 256;
+
+        std::unique_ptr<CountingFilter> counts;
 
-        Node* add_node(const Lyndon::k_finger &kf, const std::string &key_seq, const std::string &read_id, int offset, const std::string &seq);
+        static FingerGraph* from_binary_file(const std::string &file_path, int threads);
+
+        NodeShard &shard_of(const NodeKey &key);
+        // Adds to `shard` a node with `key`, which must not be in it yet
+        Node* make_node(NodeShard &shard, const NodeKey &key) const;
+
+        Node* add_node(const NodeKey &key, std::uint32_t r_id, int offset);
         void add_edge(Node* n1, Node* n2);
+        // Node with the key, which is added (with no occurrences) if missing
+        Node* get_node(const NodeKey &key);
+        // Adds to n1 the edge to n2 only, whether the graph is directed or not
+        void add_arc(Node* n1, Node* n2);
+    };
+
+    // Numbering of the nodes of a frozen graph which save() prints, i.e. those
+    // with at least two occurrences
+    class NodeIndex {
+    public:
+        static const std::uint32_t NONE = UINT32_MAX;
+
+        explicit NodeIndex(const FingerGraph &graph);
+
+        std::uint32_t size() const { return nodes.size(); }
+        const Node* operator[](std::uint32_t i) const { return nodes[i]; }
+        // Number of n, or NONE if it is not printed
+        std::uint32_t find(const Node* n) const;
+
+    private:
+        std::vector<const Node*> nodes;
+        std::vector<std::pair<const Node*, std::uint32_t>> sorted;
     };
 
     std::string get_key_factor(const factorization &factors, int begin, int end, bool normalize);
+    std::string get_key_factor(const factor_spans &factors, int begin, int end, bool normalize);
+    void get_key_factor(const FactorSpan &longest, bool normalize, std::string &key_seq);
     k_finger normalize(const k_finger &kf);
     std::string normalize(const std::string &seq);
 }
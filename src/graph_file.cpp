@@ -0,0 +1,184 @@
+#include "graph_file.h"
+#include "utils.h"
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Lyndon::GraphFile::GraphFile(const std::string &path) : data(nullptr), length_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    bool has_header = fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(GraphFileHeader);
+    if (!has_header) {
+        fprintf(stderr, "%s is truncated or corrupted\n", path.c_str());
+    } else {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            this->data = (const char *) p;
+            this->length_ = st.st_size;
+        }
+    }
+    close(fd);
+    if (this->data == nullptr) {
+        return;
+    }
+
+    if (memcmp(header().magic, "LYNDONFG", 8) != 0 || header().version != GraphFileHeader::VERSION) {
+        fprintf(stderr, "%s is not a finger graph file of version %u\n", path.c_str(), GraphFileHeader::VERSION);
+        munmap((void *) this->data, this->length_);
+        this->data = nullptr;
+    } else if (header().k < 1 || header().k > NodeKey::MAX_K) {
+        fprintf(stderr, "Cannot load a graph with k = %u (the maximum is %d)\n", header().k, NodeKey::MAX_K);
+        munmap((void *) this->data, this->length_);
+        this->data = nullptr;
+    } else if (!is_valid()) {
+        fprintf(stderr, "%s is truncated or corrupted\n", path.c_str());
+        munmap((void *) this->data, this->length_);
+        this->data = nullptr;
+    }
+}
+
+namespace {
+    // Whether the offsets o[0, n] of a section of `count` elements start at 0, end
+    // at count and never decrease
+    bool valid_offsets(const std::uint64_t *o, std::uint64_t n, std::uint64_t count) {
+        if (o[0] != 0 || o[n] != count) {
+            return false;
+        }
+        for (std::uint64_t i = 0; i < n; i++) {
+            if (o[i] > o[i + 1]) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool Lyndon::GraphFile::is_valid() const {
+    const auto &h = header();
+    auto length = (std::uint64_t) this->length_;
+    if (h.n_nodes > length || h.n_occurrences > length || h.n_edges > length
+        || h.n_reads > length || h.names_length > length) {
+        return false;
+    }
+    // Every section is aligned and lies within the file
+    auto fits = [length](std::uint64_t offset, std::uint64_t n, std::uint64_t size) {
+        return offset % 8 == 0 && offset <= length && n <= (length - offset) / size;
+    };
+    if (!fits(h.keys, h.n_nodes, sizeof(GraphFileKey)) || !fits(h.kfingers, h.n_nodes, h.k * sizeof(std::uint32_t))
+        || !fits(h.occurrence_offsets, h.n_nodes + 1, sizeof(std::uint64_t))
+        || !fits(h.occurrences, h.n_occurrences, sizeof(Occurrence))
+        || !fits(h.edge_offsets, h.n_nodes + 1, sizeof(std::uint64_t))
+        || !fits(h.edges, h.n_edges, sizeof(std::uint32_t))
+        || !fits(h.name_offsets, h.n_reads + 1, sizeof(std::uint64_t)) || !fits(h.names, h.names_length, 1)) {
+        return false;
+    }
+
+    // So are the runs of every node and read, and the indices they hold
+    if (!valid_offsets(section<std::uint64_t>(h.occurrence_offsets), h.n_nodes, h.n_occurrences)
+        || !valid_offsets(section<std::uint64_t>(h.edge_offsets), h.n_nodes, h.n_edges)
+        || !valid_offsets(name_offsets(), h.n_reads, h.names_length)) {
+        return false;
+    }
+    const auto *keys = section<GraphFileKey>(h.keys);
+    for (std::uint64_t i = 0; i < h.n_nodes; i++) {
+        if (keys[i].key_length > NodeKey::MAX_KEY_LENGTH) {
+            return false;
+        }
+    }
+    const auto *occurrences = section<Occurrence>(h.occurrences);
+    for (std::uint64_t i = 0; i < h.n_occurrences; i++) {
+        if (occurrences[i].r_id >= h.n_reads) {
+            return false;
+        }
+    }
+    const auto *edges = section<std::uint32_t>(h.edges);
+    for (std::uint64_t i = 0; i < h.n_edges; i++) {
+        if (edges[i] >= h.n_nodes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Lyndon::GraphFile::~GraphFile() {
+    if (this->data != nullptr) {
+        munmap((void *) this->data, this->length_);
+    }
+}
+
+bool Lyndon::GraphFile::is_graph_file(const std::string &path) {
+    char magic[8];
+    std::ifstream in(path, std::ios::binary);
+    return in.read(magic, sizeof(magic)) && memcmp(magic, "LYNDONFG", 8) == 0;
+}
+
+Lyndon::NodeKey Lyndon::GraphFile::key(std::uint64_t node) const {
+    const auto &h = header();
+    const auto &packed = section<GraphFileKey>(h.keys)[node];
+    const auto *kf = section<std::uint32_t>(h.kfingers) + node * h.k;
+
+    Lyndon::NodeKey key;
+    key.set_kfinger(kf, h.k);
+    key.key_bases = packed.key_bases;
+    key.key_n_mask = packed.key_n_mask;
+    key.key_length = packed.key_length;
+    key.hash = hash_key(hash_kfinger(key.kfinger()), key);
+    return key;
+}
+
+Lyndon::Range<Lyndon::Occurrence> Lyndon::GraphFile::occurrences(std::uint64_t node) const {
+    const auto *offsets = section<std::uint64_t>(header().occurrence_offsets);
+    return Lyndon::Range<Lyndon::Occurrence> {
+        section<Lyndon::Occurrence>(header().occurrences) + offsets[node],
+        (std::uint32_t) (offsets[node + 1] - offsets[node])
+    };
+}
+
+Lyndon::Range<std::uint32_t> Lyndon::GraphFile::neighbours(std::uint64_t node) const {
+    const auto *offsets = section<std::uint64_t>(header().edge_offsets);
+    return Lyndon::Range<std::uint32_t> {
+        section<std::uint32_t>(header().edges) + offsets[node],
+        (std::uint32_t) (offsets[node + 1] - offsets[node])
+    };
+}
+
+void Lyndon::GraphFile::save(std::ostream &out) const {
+    const auto &h = header();
+    std::string buffer = "HT\tk=" + std::to_string(h.k) + "\tthreshold=" + std::to_string(h.limit)
+        + "\tis_normalized=" + std::to_string(h.is_normalized) + "\tis_enriched=" + std::to_string(h.is_enriched) + "\n";
+
+    auto flush = [&out, &buffer](std::size_t size) {
+        if (buffer.length() >= size) {
+            out.write(buffer.data(), buffer.length());
+            buffer.clear();
+        }
+    };
+
+    for (std::uint64_t i = 0; i < size(); i++) {
+        append_vertex(buffer, key(i), occurrences(i), *this);
+        flush(1 << 20);
+    }
+
+    std::string label1, label2;
+    for (std::uint64_t i = 0; i < size(); i++) {
+        label1.clear();
+        append_key(label1, key(i));
+        for (auto j : neighbours(i)) {
+            label2.clear();
+            append_key(label2, key(j));
+            append_edge(buffer, label1, label2);
+            if (!h.is_directed) {
+                append_edge(buffer, label2, label1);
+            }
+        }
+        flush(1 << 20);
+    }
+    flush(0);
+}
@@ -0,0 +1,99 @@
+#ifndef LYNDON_GRAPH_FILE_H
+#define LYNDON_GRAPH_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <iostream>
+#include "finger_graph.h"
+
+namespace Lyndon {
+    // Binary finger graph, written by FingerGraph::save_binary. Like the text
+    // format, it only holds the nodes with at least two occurrences and the
+    // edges between them. All integers are little endian and every section
+    // starts at a multiple of 8 bytes, at the offset given in the header:
+    //
+    //   keys                n_nodes x GraphFileKey
+    //   kfingers            n_nodes x k x uint32
+    //   occurrence_offsets  (n_nodes + 1) x uint64, node i has occurrences[o[i], o[i + 1])
+    //   occurrences         n_occurrences x (uint32 read index, int32 offset)
+    //   edge_offsets        (n_nodes + 1) x uint64, node i has edges[e[i], e[i + 1])
+    //   edges               n_edges x uint32 node index, the neighbours of each node in key order
+    //   name_offsets        (n_reads + 1) x uint64, read r is called names[n[r], n[r + 1])
+    //   names               names_length x char
+    //
+    // As in the adjacency lists of the graph, an undirected graph stores both
+    // directions of each edge.
+    struct GraphFileHeader {
+        static const std::uint32_t VERSION = 1;
+
+        char magic[8];                      // LYNDONFG
+        std::uint32_t version;
+        std::uint32_t k;
+        std::int32_t limit;
+        std::uint8_t is_normalized;
+        std::uint8_t is_directed;
+        std::uint8_t is_enriched;
+        std::uint8_t enriched_kfingers;
+        std::uint64_t n_nodes;
+        std::uint64_t n_occurrences;
+        std::uint64_t n_edges;
+        std::uint64_t n_reads;
+        std::uint64_t names_length;
+        std::uint64_t keys;
+        std::uint64_t kfingers;
+        std::uint64_t occurrence_offsets;
+        std::uint64_t occurrences;
+        std::uint64_t edge_offsets;
+        std::uint64_t edges;
+        std::uint64_t name_offsets;
+        std::uint64_t names;
+    };
+
+    struct GraphFileKey {
+        std::uint64_t key_bases;
+        std::uint32_t key_n_mask;
+        std::uint8_t key_length;
+        std::uint8_t padding[3];
+    };
+
+    static_assert(sizeof(GraphFileHeader) == 128 && sizeof(GraphFileKey) == 16 && sizeof(Occurrence) == 8,
+                  "The layout of the graph file does not depend on the compiler");
+
+    // Read-only view of a binary graph file, which is mapped in memory and used
+    // in place. Opening it only checks that its sections and the offsets and
+    // indices they hold are within bounds, so that a truncated or corrupted file
+    // fails to open instead of being read out of bounds.
+    class GraphFile {
+    public:
+        explicit GraphFile(const std::string &path);
+        ~GraphFile();
+
+        // Whether the file starts as a binary graph file
+        static bool is_graph_file(const std::string &path);
+
+        bool is_open() const { return data != nullptr; }
+        const GraphFileHeader &header() const { return *(const GraphFileHeader *) data; }
+
+        std::uint64_t size() const { return header().n_nodes; }
+        NodeKey key(std::uint64_t node) const;
+        Range<Occurrence> occurrences(std::uint64_t node) const;
+        Range<std::uint32_t> neighbours(std::uint64_t node) const;
+
+        std::uint64_t read_count() const { return header().n_reads; }
+        const char *name(std::uint32_t r_id) const { return section<char>(header().names) + name_offsets()[r_id]; }
+        int length(std::uint32_t r_id) const { return name_offsets()[r_id + 1] - name_offsets()[r_id]; }
+
+        // Writes the graph in the text format of FingerGraph::save
+        void save(std::ostream &out) const;
+
+    private:
+        template <class T> const T *section(std::uint64_t offset) const { return (const T *) (data + offset); }
+        const std::uint64_t *name_offsets() const { return section<std::uint64_t>(header().name_offsets); }
+        bool is_valid() const;
+
+        const char *data;
+        std::size_t length_;
+    };
+}
+
+#endif //LYNDON_GRAPH_FILE_H
@@ -1,8 +1,18 @@
 #include <fstream>
 #include <iostream>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include "finger_graph.h"
+#include "factorizations.h"
+#include "fastx.h"
+#include "graph_file.h"
+#include "parallel.h"
 #include "utils.h"
 #include "argagg.h"
+#include "components.h"
+#include "unitigs.h"
+#include "gzstream.h"
 #include <zlib.h>
 #include <ctime>
 
@@ -15,22 +25,69 @@ void print_time() {
     fprintf(stderr, "[%d:%d] - ", ltm->tm_hour, ltm->tm_min);
 }
 
-//  N.B. A differenza dell'implementazione in Python, il file in input e' nel formato
-//      `read_id` `offset`|`f1` `f2` `f3`...
-//  Ai fattori e' stato gia' rimosso il bordo (oltre che applicato l'algoritmo) e `offset` e' il numero di basi rimosso.
-//  Stessa cosa vale per il file delle fattorizzazioni.
-int main(int argc, char *argv[]) {
+// Resolves the `-a` and `-b` options; returns false (after printing why) if they are invalid.
+bool get_factorization_args(argagg::parser_results &args, factorization_function &alg, border_function &border) {
+    auto alg_name = args["alg"].as<string>("cfl_icfl_comb");
+    alg = get_factorization_function(alg_name);
+    if (alg == nullptr) {
+        fprintf(stderr, "Unknown factorization algorithm %s\n", alg_name.c_str());
+        return false;
+    }
+
+    border = nullptr;
+    if (args["border"]) {
+        border = get_border_function(args["border"].as<string>());
+        if (border == nullptr) {
+            fprintf(stderr, "Unknown border strategy %s\n", args["border"].as<string>().c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Removes the borders of a read factorized as `lengths`, storing in `spans` the
+// remaining factors (which point into the read) and in `offset` the number of
+// bases removed on the left. Returns false if no factor is left.
+bool trim_read(const SequenceRecord &record, const Range<int> &lengths, border_function border,
+               factor_spans &spans, int &offset) {
+    int begin = 0, end = lengths.size();
+    if (border != nullptr) {
+        tie(begin, end) = border(lengths);
+        if (begin >= end) {
+            return false;
+        }
+    }
+
+    offset = sum(lengths, 0, begin);
+    const char *factor = record.seq.data() + offset;
+    spans.clear();
+    for (int i = begin; i < end; i++) {
+        spans.push_back(FactorSpan { factor, lengths[i] });
+        factor += lengths[i];
+    }
+    return true;
+}
+
+// Factorizes a read and removes its borders, as trim_read
+bool factorize_read(const SequenceRecord &record, factorization_function alg, border_function border,
+                    FactorizationWorkspace &ws, fingerprint &lengths, factor_spans &spans, int &offset) {
+    lengths.clear();
+    alg(record.seq.data(), record.seq.length(), lengths, ws);
+    return trim_read(record, Range<int> { lengths.data(), (std::uint32_t) lengths.size() }, border, spans, offset);
+}
+
+// Factorizes every read of a FASTA/FASTQ file (plain or gzipped) writing the
+// factorizations in the input format of `build`, as compute_factorizations.py does.
+int factorize(int argc, char *argv[]) {
     argagg::parser argparser {{
         { "help", {"-h", "--help"},
         "help", 0},
-        { "k", {"-k"},
-        "k-finger dimension", 1},
-        { "limit", {"-l", "--limit"},
-        "minimum k-finger length", 1},
-        { "no_norm", {"--no-norm"},
-        "do not normalize k-fingers", 0},
-        { "no_enriched", {"--no-enriched"},
-          "do not enrich k-fingers", 0},
+        { "alg", {"-a"},
+        "factorization algorithm {cfl,icfl,cfl_icfl,cfl_comb,icfl_comb,cfl_icfl_comb}", 1},
+        { "border", {"-b"},
+        "strategy to remove borders {remove-three,up-to-ten,twenty-most}", 1},
+        { "out", {"-o"},
+        "output file", 1},
     }};
 
     argagg::parser_results args;
@@ -42,41 +99,539 @@ int main(int argc, char *argv[]) {
     }
 
     ostringstream usage;
-    usage << "Usage: " << argv[0] << " [-k k] [-l limit] [--no-norm] [--no-enriched] FACTORS_PATH" << endl << endl;
+    usage << "Usage: " << argv[0] << " -a alg [-b border] [-o out] FASTA_PATH" << endl << endl;
     if (args["help"]) {
         cerr << usage.str();
         return 0;
     }
 
-    if (args.pos.size() == 0) {
+    if (args.pos.size() == 0 || !args["alg"]) {
         cerr << usage.str();
         return 1;
     }
 
+    factorization_function alg;
+    border_function border;
+    if (!get_factorization_args(args, alg, border)) {
+        return 1;
+    }
+
+    FastxReader reader(args.pos[0]);
+    if (!reader.is_open()) {
+        fprintf(stderr, "File %s does not exist\n", args.pos[0]);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (args["out"]) {
+        out = fopen(args["out"].as<string>().c_str(), "w");
+        if (out == nullptr) {
+            fprintf(stderr, "Cannot write %s\n", args["out"].as<string>().c_str());
+            return 1;
+        }
+    }
+
+    SequenceRecord record;
+    FactorizationWorkspace ws;
+    fingerprint lengths;
+    factor_spans factors;
+    int offset;
+    string line;
+    while (reader.next(record)) {
+        if (!factorize_read(record, alg, border, ws, lengths, factors, offset)) {
+            continue;
+        }
+
+        line.assign(record.id);
+        line += ' ';
+        line += to_string(offset);
+        line += '|';
+        for (std::size_t i = 0; i < factors.size(); i++) {
+            if (i > 0) {
+                line += ' ';
+            }
+            line.append(factors[i].begin, factors[i].length);
+        }
+        line += '\n';
+        fwrite(line.data(), 1, line.length(), out);
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
+
+// Options to build a graph, shared by `build`, `components` and `compact`
+const vector<argagg::definition> GRAPH_OPTIONS = {
+    { "k", {"-k"},
+    "k-finger dimension", 1},
+    { "limit", {"-l", "--limit"},
+    "minimum k-finger length", 1},
+    { "no_norm", {"--no-norm"},
+    "do not normalize k-fingers", 0},
+    { "no_enriched", {"--no-enriched"},
+      "do not enrich k-fingers", 0},
+    { "fasta", {"--fasta"},
+      "build from a FASTA/FASTQ file (plain or gzipped) instead of a factorizations file", 1},
+    { "alg", {"-a"},
+      "factorization algorithm for --fasta [default cfl_icfl_comb]", 1},
+    { "border", {"-b"},
+      "strategy to remove borders for --fasta", 1},
+    { "threads", {"-t", "--threads"},
+      "number of threads [default 1]", 1},
+    { "two_pass", {"--two-pass"},
+      "read the input twice, only storing the nodes found at least twice", 0},
+    { "filter_bits", {"--filter-bits"},
+      "log2 of the number of counters used by --two-pass [default 28]", 1},
+};
+const string GRAPH_USAGE = "[-k k] [-l limit] [--no-norm] [--no-enriched] [-t threads] [--two-pass]";
+
+argagg::parser make_parser(const vector<argagg::definition> &options) {
+    auto definitions = GRAPH_OPTIONS;
+    for (const auto &option : options) {
+        definitions.push_back(option);
+    }
+    return argagg::parser { definitions };
+}
+
+//  N.B. A differenza dell'implementazione in Python, il file in input e' nel formato
+//      `read_id` `offset`|`f1` `f2` `f3`...
+//  Ai fattori e' stato gia' rimosso il bordo (oltre che applicato l'algoritmo) e `offset` e' il numero di basi rimosso.
+//  Stessa cosa vale per il file delle fattorizzazioni.
+//  Con --fasta le letture vengono invece fattorizzate in memoria (-a, -b come in `factorize`).
+// Builds the graph set by GRAPH_OPTIONS from args.pos[0] or from --fasta; returns
+// nullptr (after printing why) if it cannot.
+FingerGraph* build_graph(argagg::parser_results &args) {
     auto k = args["k"].as<int>(5);
     auto limit = args["limit"].as<int>(30);
     bool no_norm = args["no_norm"];
     bool no_enriched = args["no_enriched"];
-    auto factors_path = args.pos[0];
+    auto threads = args["threads"].as<int>(1);
+    bool two_pass = args["two_pass"];
+    auto filter_bits = args["filter_bits"].as<int>(28);
+    if (k < 1 || k > NodeKey::MAX_K) {
+        fprintf(stderr, "k must be between 1 and %d (build with -DLYNDON_MAX_K=N for larger k)\n", NodeKey::MAX_K);
+        return nullptr;
+    }
+    if (filter_bits < 5 || filter_bits > 40) {
+        fprintf(stderr, "--filter-bits must be between 5 and 40\n");
+        return nullptr;
+    }
 
-    ifstream in(factors_path);
-    if (! in.good()) {
-        fprintf(stderr, "File %s does not exist\n", factors_path);
+    // Only released to the caller once it is built
+    unique_ptr<FingerGraph> graph(new FingerGraph(k, limit, !no_norm, !no_enriched));
+    if (two_pass) {
+        graph->enable_two_pass(filter_bits);
+    }
+    if (args["fasta"]) {
+        factorization_function alg;
+        border_function border;
+        if (!get_factorization_args(args, alg, border)) {
+            return nullptr;
+        }
+
+        auto fasta_path = args["fasta"].as<string>();
+        // Per thread buffers, reused across batches of reads
+        auto factorized = vector<FactorizationBatch>(max(threads, 1));
+        auto reads = vector<vector<const char*>>(factorized.size());
+        auto read_lengths = vector<vector<int>>(factorized.size());
+        auto spans = vector<factor_spans>(factorized.size());
+        // Factorizes every read of the file, passing it to `add(read, offset, factors)`
+        auto for_each_read = [&](std::function<void(const SequenceRecord &, int, const factor_spans &)> add) {
+            FastxReader reader(fasta_path);
+            if (!reader.is_open()) {
+                fprintf(stderr, "File %s does not exist\n", fasta_path.c_str());
+                return false;
+            }
+            process_batches<Batch<SequenceRecord>>(threads, [&reader](Batch<SequenceRecord> &batch) {
+                batch.clear();
+                while (batch.size < 1024) {
+                    if (!reader.next(batch.next())) {
+                        batch.size--;
+                        break;
+                    }
+                }
+                return batch.size > 0;
+            }, [&](Batch<SequenceRecord> &batch, int t) {
+                reads[t].clear();
+                read_lengths[t].clear();
+                for (size_t i = 0; i < batch.size; i++) {
+                    reads[t].push_back(batch.items[i].seq.data());
+                    read_lengths[t].push_back(batch.items[i].seq.length());
+                }
+                factorized[t].clear();
+                factorize_batch(alg, reads[t].data(), read_lengths[t].data(), batch.size, factorized[t]);
+
+                int offset;
+                for (size_t i = 0; i < batch.size; i++) {
+                    if (trim_read(batch.items[i], factorized[t].factors(i), border, spans[t], offset)) {
+                        add(batch.items[i], offset, spans[t]);
+                    }
+                }
+            });
+            return true;
+        };
+
+        if (two_pass) {
+            print_time();
+            fprintf(stderr, "Counting nodes...\n");
+            if (!for_each_read([&graph](const SequenceRecord &, int, const factor_spans &factors) {
+                graph->count_read(factors);
+            })) {
+                return nullptr;
+            }
+        }
+        print_time();
+        fprintf(stderr, "Building graph...\n");
+        if (!for_each_read([&graph](const SequenceRecord &record, int offset, const factor_spans &factors) {
+            graph->add_read(record.id, offset, factors);
+        })) {
+            return nullptr;
+        }
+    } else {
+        auto factors_path = args.pos[0];
+        ifstream in(factors_path);
+        if (! in.good()) {
+            fprintf(stderr, "File %s does not exist\n", factors_path);
+            return nullptr;
+        }
+
+        if (two_pass) {
+            print_time();
+            fprintf(stderr, "Counting nodes...\n");
+            graph->count_reads(in, threads);
+            in.clear();
+            in.seekg(0);
+        }
+        print_time();
+        fprintf(stderr, "Building graph...\n");
+        graph->add_reads(in, threads);
+    }
+    graph->freeze(threads);
+    print_time();
+    fprintf(stderr, "Done\n");
+    return graph.release();
+}
+
+int build(int argc, char *argv[]) {
+    auto argparser = make_parser({
+        { "help", {"-h", "--help"},
+        "help", 0},
+        { "out", {"-o"},
+          "output file, gzipped if it ends with .gz [default stdout]", 1},
+        { "binary", {"--binary"},
+          "write the graph to the -o file in the binary format", 0},
+    });
+
+    argagg::parser_results args;
+    try {
+        args = argparser.parse(argc, argv);
+    } catch (const std::exception& e) {
+        cerr << e.what() << endl;
         return 1;
     }
 
-    FingerGraph* graph;
+    ostringstream usage;
+    usage << "Usage: " << argv[0] << " " << GRAPH_USAGE << " [-o out [--binary]] FACTORS_PATH" << endl
+          << "       " << argv[0] << " " << GRAPH_USAGE << " [-o out [--binary]] [-a alg] [-b border] --fasta FASTA_PATH"
+          << endl << endl;
+    if (args["help"]) {
+        cerr << usage.str();
+        return 0;
+    }
+
+    if (args.pos.size() == 0 && !args["fasta"]) {
+        cerr << usage.str();
+        return 1;
+    }
+
+    auto threads = args["threads"].as<int>(1);
+    bool binary = args["binary"];
+    if (binary && !args["out"]) {
+        fprintf(stderr, "--binary needs an output file (-o)\n");
+        return 1;
+    }
+
+    // Output: a gzipped file is compressed by save() itself when there are more
+    // threads, so that they compress separate blocks in parallel
+    unique_ptr<ostream> out_file;
+    bool gzip = false;
+    if (args["out"]) {
+        auto out_path = args["out"].as<string>();
+        bool gz = out_path.length() > 3 && out_path.compare(out_path.length() - 3, 3, ".gz") == 0;
+        bool is_open;
+        if (binary) {
+            gz = false;
+        }
+        if (gz && threads <= 1) {
+            auto gz_file = new ogzstream(out_path.c_str());
+            is_open = gz_file->rdbuf()->is_open();
+            out_file.reset(gz_file);
+        } else {
+            out_file.reset(new ofstream(out_path, ios::binary));
+            is_open = out_file->good();
+            gzip = gz;
+        }
+        if (!is_open) {
+            fprintf(stderr, "Cannot write %s\n", out_path.c_str());
+            return 1;
+        }
+    }
+
+    auto graph = build_graph(args);
+    if (graph == nullptr) {
+        return 1;
+    }
     print_time();
-    fprintf(stderr, "Building graph...\n");
-    graph = new FingerGraph(in, k, limit, !no_norm, !no_enriched);
+    fprintf(stderr, "Printing graph...\n");
+    if (binary) {
+        graph->save_binary(*out_file);
+    } else {
+        graph->save(out_file ? *out_file : cout, threads, gzip);
+    }
+    out_file.reset();
     print_time();
     fprintf(stderr, "Done\n");
+
+
+    return 0;
+}
+
+// Loads the graph of the -g file or builds it as in `build`; returns nullptr
+// (after printing why) if it cannot.
+FingerGraph* load_graph(argagg::parser_results &args) {
+    if (!args["graph"]) {
+        return build_graph(args);
+    }
+    auto graph_path = args["graph"].as<string>();
     print_time();
-    fprintf(stderr, "Printing graph...\n");
-    graph->save();
+    fprintf(stderr, "Loading graph...\n");
+    auto graph = FingerGraph::from_graph_file(graph_path, args["threads"].as<int>(1));
+    if (graph == nullptr) {
+        fprintf(stderr, "Cannot read %s\n", graph_path.c_str());
+    }
+    return graph;
+}
+
+// Connected components of a graph, either built as in `build` or loaded with -g
+int components(int argc, char *argv[]) {
+    auto argparser = make_parser({
+        { "help", {"-h", "--help"},
+        "help", 0},
+        { "graph", {"-g", "--graph"},
+          "load the graph from a file written by build (text, gzipped or binary) instead of building it", 1},
+        { "out", {"-o"},
+          "output file [default stdout]", 1},
+        { "clusters", {"--clusters"},
+          "also connect the nodes of each read, and write its cluster as `read_id\\tcomponent`", 0},
+    });
+
+    argagg::parser_results args;
+    try {
+        args = argparser.parse(argc, argv);
+    } catch (const std::exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    ostringstream usage;
+    usage << "Usage: " << argv[0] << " [-t threads] [-o out] [--clusters] -g GRAPH_PATH" << endl
+          << "       " << argv[0] << " " << GRAPH_USAGE << " [-o out] [--clusters] FACTORS_PATH" << endl
+          << "       " << argv[0] << " " << GRAPH_USAGE << " [-o out] [--clusters] [-a alg] [-b border] --fasta FASTA_PATH"
+          << endl << endl
+          << "Writes a line `component\tnodes\treads\tread_id1 read_id2 ...` per component or, with --clusters,"
+          << " a line `read_id\tcomponent` per read" << endl;
+    if (args["help"]) {
+        cerr << usage.str();
+        return 0;
+    }
+
+    if (args.pos.size() == 0 && !args["fasta"] && !args["graph"]) {
+        cerr << usage.str();
+        return 1;
+    }
+
+    auto threads = args["threads"].as<int>(1);
+    ofstream out_file;
+    if (args["out"]) {
+        out_file.open(args["out"].as<string>());
+        if (!out_file.good()) {
+            fprintf(stderr, "Cannot write %s\n", args["out"].as<string>().c_str());
+            return 1;
+        }
+    }
+    ostream &out = args["out"] ? out_file : cout;
+
+    auto graph = load_graph(args);
+    if (graph == nullptr) {
+        return 1;
+    }
+
+    print_time();
+    fprintf(stderr, "Finding components...\n");
+    bool clusters = args["clusters"];
+    Components ccs(*graph, threads, clusters);
+    print_time();
+    fprintf(stderr, "%u components of %u nodes\n", ccs.size(), ccs.nodes.size());
+    if (clusters) {
+        ccs.save_clusters(out);
+    } else {
+        ccs.save(out, threads);
+    }
     print_time();
     fprintf(stderr, "Done\n");
+    return 0;
+}
+
+// Unitigs of a graph, either built as in `build` or loaded with -g
+int compact(int argc, char *argv[]) {
+    auto argparser = make_parser({
+        { "help", {"-h", "--help"},
+        "help", 0},
+        { "graph", {"-g", "--graph"},
+          "load the graph from a file written by build (text, gzipped or binary) instead of building it", 1},
+        { "out", {"-o"},
+          "output file [default stdout]", 1},
+    });
+
+    argagg::parser_results args;
+    try {
+        args = argparser.parse(argc, argv);
+    } catch (const std::exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
 
+    ostringstream usage;
+    usage << "Usage: " << argv[0] << " [-t threads] [-o out] -g GRAPH_PATH" << endl
+          << "       " << argv[0] << " " << GRAPH_USAGE << " [-o out] FACTORS_PATH" << endl
+          << "       " << argv[0] << " " << GRAPH_USAGE << " [-o out] [-a alg] [-b border] --fasta FASTA_PATH"
+          << endl << endl
+          << "Writes the graph with its non-branching paths merged into unitigs, as lines"
+          << " `UT\tunitig\t(f_1, ..., f_m)\tnodes\t{('read_id', offset), ...}` and `UE\tunitig1\tunitig2`" << endl;
+    if (args["help"]) {
+        cerr << usage.str();
+        return 0;
+    }
+
+    if (args.pos.size() == 0 && !args["fasta"] && !args["graph"]) {
+        cerr << usage.str();
+        return 1;
+    }
 
+    auto threads = args["threads"].as<int>(1);
+    ofstream out_file;
+    if (args["out"]) {
+        out_file.open(args["out"].as<string>());
+        if (!out_file.good()) {
+            fprintf(stderr, "Cannot write %s\n", args["out"].as<string>().c_str());
+            return 1;
+        }
+    }
+    ostream &out = args["out"] ? out_file : cout;
+
+    auto graph = load_graph(args);
+    if (graph == nullptr) {
+        return 1;
+    }
+
+    print_time();
+    fprintf(stderr, "Compacting...\n");
+    Unitigs unitigs(*graph, threads);
+    print_time();
+    fprintf(stderr, "%u unitigs of %u nodes\n", unitigs.size(), unitigs.nodes.size());
+    unitigs.save(out, threads);
+    print_time();
+    fprintf(stderr, "Done\n");
     return 0;
 }
+
+// Prints a graph (binary, or text and possibly gzipped) in the text format,
+// or converts it to the binary format with -o and --binary
+int view(int argc, char *argv[]) {
+    argagg::parser argparser {{
+        { "help", {"-h", "--help"},
+        "help", 0},
+        { "threads", {"-t", "--threads"},
+          "number of threads used to load a text graph [default 1]", 1},
+        { "out", {"-o"},
+          "output file [default stdout]", 1},
+        { "binary", {"--binary"},
+          "write the graph to the -o file in the binary format", 0},
+    }};
+
+    argagg::parser_results args;
+    try {
+        args = argparser.parse(argc, argv);
+    } catch (const std::exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    ostringstream usage;
+    usage << "Usage: " << argv[0] << " [-t threads] [-o out [--binary]] GRAPH_PATH" << endl << endl;
+    if (args["help"]) {
+        cerr << usage.str();
+        return 0;
+    }
+    if (args.pos.size() == 0 || (args["binary"] && !args["out"])) {
+        cerr << usage.str();
+        return 1;
+    }
+
+    auto threads = args["threads"].as<int>(1);
+    ofstream out_file;
+    if (args["out"]) {
+        out_file.open(args["out"].as<string>(), ios::binary);
+        if (!out_file.good()) {
+            fprintf(stderr, "Cannot write %s\n", args["out"].as<string>().c_str());
+            return 1;
+        }
+    }
+    ostream &out = args["out"] ? out_file : cout;
+
+    if (GraphFile::is_graph_file(args.pos[0])) {
+        if (args["binary"]) {
+            fprintf(stderr, "%s is a binary graph already\n", args.pos[0]);
+            return 1;
+        }
+        GraphFile graph(args.pos[0]);
+        if (!graph.is_open()) {
+            return 1;
+        }
+        graph.save(out);
+        return 0;
+    }
+
+    auto graph = FingerGraph::from_graph_file(args.pos[0], threads);
+    if (graph == nullptr) {
+        fprintf(stderr, "Cannot read %s\n", args.pos[0]);
+        return 1;
+    }
+    if (args["binary"]) {
+        graph->save_binary(out);
+    } else {
+        graph->save(out, threads);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "factorize") == 0) {
+        return factorize(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "components") == 0) {
+        return components(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "compact") == 0) {
+        return compact(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "view") == 0) {
+        return view(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "build") == 0) {
+        return build(argc - 1, argv + 1);
+    }
+    return build(argc, argv);
+}
@@ -0,0 +1,164 @@
+#ifndef LYNDON_PARALLEL_H
+#define LYNDON_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Lyndon {
+    // Items of a batch are overwritten in place when the batch is refilled, so
+    // their own buffers are reused too.
+    template <class T> struct Batch {
+        std::vector<T> items;
+        std::size_t size = 0;
+
+        void clear() { size = 0; }
+        T &next() {
+            if (size == items.size()) {
+                items.emplace_back();
+            }
+            return items[size++];
+        }
+    };
+
+    // Runs `work(i)` for every i in [0, n) on `n_threads` threads
+    template <class Work> void parallel_for(int n_threads, std::size_t n, Work work) {
+        std::atomic<std::size_t> next(0);
+        auto run = [&]() {
+            for (std::size_t i = next++; i < n; i = next++) {
+                work(i);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < n_threads; t++) {
+            workers.emplace_back(run);
+        }
+        run();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Loops over many small items (nodes, components, ...) hand them out to the
+    // threads in blocks of BLOCK_SIZE
+    const std::size_t BLOCK_SIZE = 4096;
+
+    inline std::size_t block_count(std::size_t n) { return (n + BLOCK_SIZE - 1) / BLOCK_SIZE; }
+
+    // Runs `work(block, begin, end)` on `n_threads` threads for every block
+    // [begin, end) of BLOCK_SIZE items of [0, n)
+    template <class Work> void parallel_for_blocks(int n_threads, std::size_t n, Work work) {
+        parallel_for(n_threads, block_count(n), [&](std::size_t block) {
+            work(block, block * BLOCK_SIZE, std::min(n, (block + 1) * BLOCK_SIZE));
+        });
+    }
+
+    // Writes to `out`, in order, the text of the blocks [0, n_blocks), which
+    // `format(block, buffer)` appends to an empty buffer. Groups of blocks are
+    // formatted in parallel, each into its own buffer, so the buffers are reused
+    // from a group to the next.
+    template <class Format> void write_blocks(std::ostream &out, int n_threads, std::size_t n_blocks, Format format) {
+        n_threads = std::max(n_threads, 1);
+        std::vector<std::string> buffers(n_threads > 1 ? 2 * n_threads : 1);
+        for (std::size_t first = 0; first < n_blocks; first += buffers.size()) {
+            auto n = std::min(buffers.size(), n_blocks - first);
+            parallel_for(n_threads, n, [&](std::size_t i) {
+                buffers[i].clear();
+                format(first + i, buffers[i]);
+            });
+            for (std::size_t i = 0; i < n; i++) {
+                out.write(buffers[i].data(), buffers[i].length());
+            }
+        }
+    }
+
+    // Producer/consumer loop: the calling thread fills batches with `read(batch)`
+    // (which returns false when the input is over) and `n_threads` workers run
+    // `work(batch, thread_idx)` on them. Batches are recycled, so a reader reusing
+    // their storage (e.g. by assigning to strings already in the batch) stops
+    // allocating once every batch has been filled once. With a single thread
+    // everything runs on the calling thread.
+    template <class Chunk, class Read, class Work> void process_batches(int n_threads, Read read, Work work) {
+        if (n_threads <= 1) {
+            Chunk batch;
+            while (read(batch)) {
+                work(batch, 0);
+            }
+            return;
+        }
+
+        std::mutex lock;
+        std::condition_variable has_full, has_empty;
+        std::vector<Chunk> batches(2 * n_threads);
+        std::deque<Chunk*> full, empty;
+        for (auto &batch : batches) {
+            empty.push_back(&batch);
+        }
+        bool done = false;
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < n_threads; t++) {
+            workers.emplace_back([&, t]() {
+                while (true) {
+                    Chunk *batch;
+                    {
+                        std::unique_lock<std::mutex> guard(lock);
+                        has_full.wait(guard, [&]() { return !full.empty() || done; });
+                        if (full.empty()) {
+                            return;
+                        }
+                        batch = full.front();
+                        full.pop_front();
+                    }
+
+                    work(*batch, t);
+
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        empty.push_back(batch);
+                    }
+                    has_empty.notify_one();
+                }
+            });
+        }
+
+        while (true) {
+            Chunk *batch;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                has_empty.wait(guard, [&]() { return !empty.empty(); });
+                batch = empty.front();
+                empty.pop_front();
+            }
+
+            bool more = read(*batch);
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (more) {
+                    full.push_back(batch);
+                } else {
+                    done = true;
+                }
+            }
+            if (!more) {
+                has_full.notify_all();
+                break;
+            }
+            has_full.notify_one();
+        }
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+}
+
+#endif //LYNDON_PARALLEL_H
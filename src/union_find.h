@@ -0,0 +1,78 @@
+#ifndef LYNDON_UNION_FIND_H
+#define LYNDON_UNION_FIND_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace Lyndon {
+    // Disjoint sets of the integers [0, n), with union by rank and path halving.
+    // Every element is an atomic word holding its rank (high half) and its parent
+    // (low half), which is only changed with compare-and-swap, so unite() and
+    // find() can be called by any number of threads at once without locks.
+    class UnionFind {
+    public:
+        explicit UnionFind(std::uint32_t n) : entries(n) {
+            for (std::uint32_t i = 0; i < n; i++) {
+                entries[i].store(i, std::memory_order_relaxed);
+            }
+        }
+
+        std::uint32_t size() const { return entries.size(); }
+
+        std::uint32_t find(std::uint32_t x) {
+            while (true) {
+                auto entry = entries[x].load(std::memory_order_relaxed);
+                auto parent = parent_of(entry);
+                if (parent == x) {
+                    return x;
+                }
+                auto grandparent = parent_of(entries[parent].load(std::memory_order_relaxed));
+                if (grandparent != parent) {
+                    // Path halving: x skips its parent, if nobody changed x meanwhile
+                    entries[x].compare_exchange_weak(entry, make(rank_of(entry), grandparent), std::memory_order_relaxed);
+                }
+                x = grandparent;
+            }
+        }
+
+        void unite(std::uint32_t x, std::uint32_t y) {
+            while (true) {
+                x = find(x);
+                y = find(y);
+                if (x == y) {
+                    return;
+                }
+
+                auto x_rank = rank_of(entries[x].load(std::memory_order_relaxed));
+                auto y_rank = rank_of(entries[y].load(std::memory_order_relaxed));
+                // x, the root with the lower rank (or index, on ties), goes under y
+                if (x_rank > y_rank || (x_rank == y_rank && x > y)) {
+                    std::swap(x, y);
+                    std::swap(x_rank, y_rank);
+                }
+
+                auto x_entry = make(x_rank, x);
+                if (!entries[x].compare_exchange_strong(x_entry, make(x_rank, y), std::memory_order_relaxed)) {
+                    continue;   // x is not a root (or its rank changed) anymore
+                }
+                if (x_rank == y_rank) {
+                    auto y_entry = make(y_rank, y);
+                    entries[y].compare_exchange_strong(y_entry, make(y_rank + 1, y), std::memory_order_relaxed);
+                }
+                return;
+            }
+        }
+
+    private:
+        static std::uint64_t make(std::uint32_t rank, std::uint32_t parent) {
+            return (std::uint64_t) rank << 32 | parent;
+        }
+        static std::uint32_t parent_of(std::uint64_t entry) { return (std::uint32_t) entry; }
+        static std::uint32_t rank_of(std::uint64_t entry) { return entry >> 32; }
+
+        std::vector<std::atomic<std::uint64_t>> entries;
+    };
+}
+
+#endif //LYNDON_UNION_FIND_H
@@ -0,0 +1,274 @@
+#include "unitigs.h"
+#include "parallel.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace {
+    const std::uint32_t NONE = Lyndon::NodeIndex::NONE;
+
+    enum Side : std::uint8_t { LEFT = 0, RIGHT = 1, UNCLEAR = 2 };
+
+    // Edge from a node, leaving from its side `from` and reaching node `to` on its side `side_to`
+    struct Arc {
+        std::uint32_t to;
+        std::uint8_t from;
+        std::uint8_t side_to;
+    };
+
+    // i-th length of the k-finger of key, read forwards or backwards
+    int length_at(const Lyndon::NodeKey &key, int i, bool forward) {
+        return key.kf[forward ? i : key.k - 1 - i];
+    }
+
+    // Whether the k-finger of x is followed by that of y, both oriented
+    bool follows(const Lyndon::NodeKey &x, bool x_forward, const Lyndon::NodeKey &y, bool y_forward) {
+        for (int i = 1; i < x.k; i++) {
+            if (length_at(x, i, x_forward) != length_at(y, i - 1, y_forward)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Sides of x and y joined by the undirected edge x - y, which are UNCLEAR
+    // unless the k-fingers overlap in exactly one way
+    Arc undirected_arc(const Lyndon::NodeKey &x, const Lyndon::NodeKey &y, std::uint32_t to) {
+        Arc overlaps[] = {
+            { to, RIGHT, LEFT }, { to, RIGHT, RIGHT }, { to, LEFT, RIGHT }, { to, LEFT, LEFT }
+        };
+        bool matches[] = {
+            follows(x, true, y, true), follows(x, true, y, false), follows(y, true, x, true), follows(y, false, x, true)
+        };
+        Arc result = { to, UNCLEAR, UNCLEAR };
+        int n_matches = 0;
+        for (int i = 0; i < 4; i++) {
+            if (matches[i]) {
+                result = overlaps[i];
+                n_matches++;
+            }
+        }
+        return n_matches == 1 ? result : Arc { to, UNCLEAR, UNCLEAR };
+    }
+
+    // Chain of nodes found by a walk, with its fingerprint
+    struct Chain {
+        std::vector<std::uint32_t> path;
+        std::vector<int> lengths;
+    };
+}
+
+Lyndon::Unitigs::Unitigs(const Lyndon::FingerGraph &graph, int threads) : graph(graph), nodes(graph) {
+    auto n = this->nodes.size();
+    int k = graph.k;
+    auto n_blocks = block_count(n);
+
+    // Arcs of every node, on both of its sides. A directed edge x -> y is the
+    // arc (y, RIGHT, LEFT) of x and the arc (x, LEFT, RIGHT) of y.
+    std::vector<std::vector<std::pair<std::uint32_t, Arc>>> block_arcs(n_blocks);
+    Lyndon::parallel_for_blocks(threads, n, [&](std::size_t block, std::size_t begin, std::size_t end) {
+        for (std::uint32_t i = begin; i < end; i++) {
+            for (const Node* n2 : this->nodes[i]->adj_list) {
+                auto j = this->nodes.find(n2);
+                if (j == NONE) {
+                    continue;
+                }
+                if (graph.is_directed) {
+                    block_arcs[block].emplace_back(i, Arc { j, RIGHT, LEFT });
+                    block_arcs[block].emplace_back(j, Arc { i, LEFT, RIGHT });
+                } else if (i == j) {
+                    block_arcs[block].emplace_back(i, Arc { j, UNCLEAR, UNCLEAR });
+                } else {
+                    block_arcs[block].emplace_back(i, undirected_arc(this->nodes[i]->key, n2->key, j));
+                }
+            }
+        }
+    });
+    std::vector<std::uint64_t> arc_first(n + 1, 0);
+    for (const auto &arcs : block_arcs) {
+        for (const auto &arc : arcs) {
+            arc_first[arc.first + 1]++;
+        }
+    }
+    for (std::uint32_t i = 0; i < n; i++) {
+        arc_first[i + 1] += arc_first[i];
+    }
+    std::vector<Arc> arcs(arc_first[n]);
+    {
+        std::vector<std::uint64_t> next(arc_first.begin(), arc_first.end() - 1);
+        for (auto &block : block_arcs) {
+            for (const auto &arc : block) {
+                arcs[next[arc.first]++] = arc.second;
+            }
+            std::vector<std::pair<std::uint32_t, Arc>>().swap(block);
+        }
+    }
+
+    // Arcs on each side of every node, where an unclear arc blocks both sides
+    std::vector<std::uint8_t> degree(2 * n, 0);
+    for (std::uint32_t i = 0; i < n; i++) {
+        for (auto a = arc_first[i]; a < arc_first[i + 1]; a++) {
+            for (int side = LEFT; side <= RIGHT; side++) {
+                if (arcs[a].from == side || arcs[a].from == UNCLEAR) {
+                    degree[2 * i + side] = std::min(degree[2 * i + side] + (arcs[a].from == UNCLEAR ? 2 : 1), 2);
+                }
+            }
+        }
+    }
+    // The arc leaving node i from `side`, if it is merged
+    auto merged_arc = [&](std::uint32_t i, int side) -> const Arc* {
+        if (degree[2 * i + side] != 1) {
+            return nullptr;
+        }
+        for (auto a = arc_first[i]; a < arc_first[i + 1]; a++) {
+            const auto &arc = arcs[a];
+            if (arc.from == side) {
+                return arc.to != i && degree[2 * arc.to + arc.side_to] == 1 ? &arc : nullptr;
+            }
+        }
+        return nullptr;
+    };
+
+    // Walks the chain from node s leaving from `side`, up to its end or back to s
+    auto walk = [&](std::uint32_t s, int side, Chain &chain) {
+        chain.path.clear();
+        chain.lengths.clear();
+        const auto &key = this->nodes[s]->key;
+        chain.path.push_back(s);
+        for (int i = 0; i < k; i++) {
+            chain.lengths.push_back(length_at(key, i, side == RIGHT));
+        }
+        for (auto arc = merged_arc(s, side); arc != nullptr && arc->to != s; ) {
+            const auto &next_key = this->nodes[arc->to]->key;
+            chain.path.push_back(arc->to);
+            chain.lengths.push_back(arc->side_to == LEFT ? next_key.kf[k - 1] : next_key.kf[0]);
+            arc = merged_arc(arc->to, 1 - arc->side_to);
+        }
+    };
+
+    // Chains start from the nodes with a side which is not merged; chains of an
+    // undirected graph are walked from both ends, and kept from the lower one
+    std::vector<std::vector<Chain>> block_chains(n_blocks);
+    Lyndon::parallel_for_blocks(threads, n, [&](std::size_t block, std::size_t begin, std::size_t end) {
+        Chain chain;
+        for (std::uint32_t i = begin; i < end; i++) {
+            bool left = merged_arc(i, LEFT) != nullptr, right = merged_arc(i, RIGHT) != nullptr;
+            if (left && (right || graph.is_directed)) {
+                continue;
+            }
+            walk(i, left ? LEFT : RIGHT, chain);
+            if (graph.is_directed || chain.path.front() <= chain.path.back()) {
+                block_chains[block].push_back(chain);
+            }
+        }
+    });
+
+    this->unitig.assign(n, NONE);
+    this->position.resize(n);
+    this->first.assign(1, 0);
+    auto add_chain = [this](const Chain &chain) {
+        auto u = size();
+        for (std::uint32_t p = 0; p < chain.path.size(); p++) {
+            this->unitig[chain.path[p]] = u;
+            this->position[chain.path[p]] = p;
+        }
+        this->path.insert(this->path.end(), chain.path.begin(), chain.path.end());
+        this->lengths.insert(this->lengths.end(), chain.lengths.begin(), chain.lengths.end());
+        this->first.push_back(this->path.size());
+    };
+    for (auto &chains : block_chains) {
+        for (const auto &chain : chains) {
+            add_chain(chain);
+        }
+        std::vector<Chain>().swap(chains);
+    }
+
+    // What is left are cycles of merged edges
+    Chain chain;
+    for (std::uint32_t i = 0; i < n; i++) {
+        if (this->unitig[i] == NONE) {
+            walk(i, RIGHT, chain);
+            add_chain(chain);
+        }
+    }
+}
+
+Lyndon::Range<std::uint32_t> Lyndon::Unitigs::members(std::uint32_t u) const {
+    return Lyndon::Range<std::uint32_t> { this->path.data() + this->first[u], this->first[u + 1] - this->first[u] };
+}
+
+Lyndon::Range<int> Lyndon::Unitigs::fingerprint(std::uint32_t u) const {
+    auto k = this->graph.k;
+    return Lyndon::Range<int> {
+        this->lengths.data() + this->first[u] + (k - 1) * u,
+        this->first[u + 1] - this->first[u] + k - 1
+    };
+}
+
+void Lyndon::Unitigs::save(std::ostream &out, int threads) const {
+    auto header = this->graph.header();
+    out.write(header.data(), header.length());
+
+    // Unitigs are formatted a block at a time
+    const auto &reads = this->graph.reads;
+    write_blocks(out, threads, block_count(size()), [&](std::size_t block, std::string &buffer) {
+        std::vector<Occurrence> occs;
+        auto end = std::min<std::size_t>(size(), (block + 1) * BLOCK_SIZE);
+        for (auto u = block * BLOCK_SIZE; u < end; u++) {
+            occs.clear();
+            for (auto node : members(u)) {
+                occs.insert(occs.end(), this->nodes[node]->occs.begin(), this->nodes[node]->occs.end());
+            }
+            std::sort(occs.begin(), occs.end());
+            occs.erase(std::unique(occs.begin(), occs.end()), occs.end());
+
+            buffer.append("UT\t", 3);
+            append_int(buffer, u);
+            buffer.append("\t(", 2);
+            bool first = true;
+            for (auto length : fingerprint(u)) {
+                if (!first) {
+                    buffer.append(", ", 2);
+                }
+                first = false;
+                append_int(buffer, length);
+            }
+            buffer.append(")\t", 2);
+            append_int(buffer, members(u).size());
+            buffer += '\t';
+            append_occurrences(buffer, Range<Occurrence> { occs.data(), (std::uint32_t) occs.size() }, reads);
+            buffer += '\n';
+        }
+    });
+
+    // Edges between unitigs, and those closing a cycle
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+    for (std::uint32_t i = 0; i < this->nodes.size(); i++) {
+        for (const Node* n2 : this->nodes[i]->adj_list) {
+            auto j = this->nodes.find(n2);
+            if (j == NONE) {
+                continue;
+            }
+            auto u1 = this->unitig[i], u2 = this->unitig[j];
+            auto p1 = this->position[i], p2 = this->position[j];
+            if (u1 == u2 && (p2 == p1 + 1 || (!this->graph.is_directed && p1 == p2 + 1))) {
+                continue;
+            }
+            if (!this->graph.is_directed && u1 > u2) {
+                std::swap(u1, u2);
+            }
+            edges.emplace_back(u1, u2);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    std::string buffer;
+    for (const auto &edge : edges) {
+        buffer.append("UE\t", 3);
+        append_int(buffer, edge.first);
+        buffer += '\t';
+        append_int(buffer, edge.second);
+        buffer += '\n';
+    }
+    out.write(buffer.data(), buffer.length());
+}
@@ -0,0 +1,53 @@
+#ifndef LYNDON_UNITIGS_H
+#define LYNDON_UNITIGS_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "finger_graph.h"
+
+namespace Lyndon {
+    // Compaction of a frozen graph: the nodes which save() prints (those with
+    // at least two occurrences) are merged into unitigs, the maximal chains of
+    // nodes linked by non-branching edges, as in de Bruijn graphs.
+    //
+    // Every node has two sides, where the k-fingers of its neighbours overlap
+    // its first or its last k - 1 lengths: in a directed graph the successors
+    // are on the right and the predecessors on the left, in an undirected one
+    // (whose k-fingers are normalized) the side is found from the overlap, and
+    // edges whose side is not clear are never merged. An edge is merged when it
+    // is the only one on the sides of both of its nodes. The fingerprint of a
+    // unitig is the k-finger of its first node followed by the last length of
+    // each of the following nodes, read in the direction of the chain.
+    class Unitigs {
+    public:
+        Unitigs(const FingerGraph &graph, int threads = 1);
+
+        std::uint32_t size() const { return first.size() - 1; }
+        // Nodes of unitig u in order, as numbers of `nodes`
+        Range<std::uint32_t> members(std::uint32_t u) const;
+        Range<int> fingerprint(std::uint32_t u) const;
+        std::uint32_t unitig_of(std::uint32_t node) const { return unitig[node]; }
+
+        // Writes the header of the graph, then a line per unitig
+        //   UT\tunitig\t(f_1, ..., f_m)\tnodes\t{('read_id', offset), ...}
+        // with the occurrences of all its nodes, then a line per edge between
+        // unitigs (once per pair if the graph is undirected)
+        //   UE\tunitig1\tunitig2
+        void save(std::ostream &out, int threads = 1) const;
+
+        const FingerGraph &graph;
+        NodeIndex nodes;
+
+    private:
+        // Unitig u is path[first[u], first[u + 1]), with fingerprint
+        // lengths[first[u] + (k - 1) * u, first[u + 1] + (k - 1) * (u + 1))
+        std::vector<std::uint32_t> path;
+        std::vector<std::uint32_t> first;
+        std::vector<int> lengths;
+        std::vector<std::uint32_t> unitig;
+        std::vector<std::uint32_t> position;
+    };
+}
+
+#endif //LYNDON_UNITIGS_H
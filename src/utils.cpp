@@ -4,6 +4,11 @@
 #include <fstream>
 #include "utils.h"
 #include <ctime>
+#include <algorithm>
+#include <zlib.h>
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
 
 void log(const char * format, ...) {
     time_t t = time(0);
@@ -18,7 +23,7 @@ void log(const char * format, ...) {
     flush(std::cout);
 }
 
-std::tuple<int, int> remove_three(const Lyndon::fingerprint &fingerprint) {
+std::tuple<int, int> remove_three(const Lyndon::Range<int> &fingerprint) {
     auto size = fingerprint.size();
     if (size > 6) {
         return std::make_tuple(3, size - 3);
@@ -27,26 +32,51 @@ std::tuple<int, int> remove_three(const Lyndon::fingerprint &fingerprint) {
     }
 }
 
-std::tuple<int, int> up_to_ten(const Lyndon::fingerprint &fingerprint) {
-    auto size = fingerprint.size();
+std::tuple<int, int> up_to_ten(const Lyndon::Range<int> &fingerprint) {
+    int size = fingerprint.size();
     if (size < 3) {
         return std::make_tuple(0, 0);
     }
 
-    unsigned long left = 1, right = size - 2, sum = fingerprint[0];
-    while (left < size && sum + fingerprint[left] <= 10) {
+    int left = 1, right = size - 1, sum = fingerprint[0];
+    while (left < right && sum + fingerprint[left] <= 10) {
         sum += fingerprint[left];
         left++;
     }
 
     sum = fingerprint[size - 1];
-    while (right >= 0 && sum + fingerprint[right] <= 10) {
-        sum += fingerprint[right];
+    while (left < right && sum + fingerprint[right - 1] <= 10) {
+        sum += fingerprint[right - 1];
         right--;
     }
 
-    return std::make_tuple(left, right + 1);
+    return std::make_tuple(left, right);
+}
+
+std::tuple<int, int> twenty_most(const Lyndon::Range<int> &fingerprint) {
+    int size = fingerprint.size();
+    int left = std::min(size, 2), right = std::min(size, 2);
+    if (sum(fingerprint, 0, left) >= 20) {
+        left = std::min(size, 1);
+    }
+    if (sum(fingerprint, size - right, size) >= 20) {
+        right = std::min(size, 1);
+    }
 
+    return std::make_tuple(left, size - right);
+}
+
+border_function get_border_function(const std::string &name) {
+    if (name == "remove-three") {
+        return remove_three;
+    }
+    if (name == "up-to-ten") {
+        return up_to_ten;
+    }
+    if (name == "twenty-most") {
+        return twenty_most;
+    }
+    return nullptr;
 }
 
 std::string v2s(const std::vector<int> &v, const std::string &sep)
@@ -61,11 +91,11 @@ std::string v2s(const std::vector<int> &v, const std::string &sep)
     return res;
 }
 
-std::string map2str(const std::map<Lyndon::Occurrence, std::string> &m) {
+std::string map2str(const std::map<Lyndon::Occurrence, std::string> &m, const Lyndon::ReadTable &reads) {
     std::string result = "{";
 
     for (auto it = m.begin(); it != m.end(); ) {
-        result += it->first.to_string();
+        result += it->first.to_string(reads);
         result += ": ";
         result += "'" + it->second + "'";
 
@@ -81,11 +111,11 @@ std::string map2str(const std::map<Lyndon::Occurrence, std::string> &m) {
     return result;
 }
 
-std::string set2str(const std::set<Lyndon::Occurrence> &occs) {
+std::string set2str(const Lyndon::Range<Lyndon::Occurrence> &occs, const Lyndon::ReadTable &reads) {
     std::string result = "{";
 
     for (auto it = occs.begin(); it != occs.end(); ) {
-        result += (*it).to_string();
+        result += (*it).to_string(reads);
         it++;
         if (it != occs.end()) {
             result += ", ";
@@ -134,6 +164,17 @@ Lyndon::fingerprint facts2fingerprint(const std::vector<std::string> &facts) {
     return result;
 }
 
+Lyndon::factorization fingerprint2facts(const std::string &s, const Lyndon::fingerprint &fingerprint, int start) {
+    Lyndon::factorization result(fingerprint.size());
+
+    for (int i = 0; i < result.size(); i++) {
+        result[i] = s.substr(start, fingerprint[i]);
+        start += fingerprint[i];
+    }
+
+    return result;
+}
+
 std::string &ltrim(std::string &str, const std::string &chars)
 {
     str.erase(0, str.find_first_not_of(chars));
@@ -157,6 +198,10 @@ std::string &trim(std::string &str, const std::string &chars)
 }
 
 int sum(const std::vector<int> &v, int start, int end) {
+    return sum(Lyndon::Range<int> { v.data(), (std::uint32_t) v.size() }, start, end);
+}
+
+int sum(const Lyndon::Range<int> &v, int start, int end) {
     if (end == -1 || end > v.size()) {
         end = v.size();
     }
@@ -199,35 +244,340 @@ std::string join(const std::vector<std::string> &v, std::string s, int start, in
     return result;
 }
 
-std::string reverse_complement(const std::string &seq) {
-    auto result = std::string(seq.rbegin(), seq.rend());
-    for (int i = 0; i < result.length(); i++) {
-        result[i] = complement(result[i]);
+const char COMPLEMENT[256] = {
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'T', 'V', 'G', 'H', 'N', 'N', 'C', 'D', 'N', 'N', 'M', 'N', 'K', 'N', 'N',
+    'N', 'N', 'Y', 'S', 'A', 'A', 'B', 'W', 'N', 'R', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 't', 'v', 'g', 'h', 'n', 'n', 'c', 'd', 'n', 'n', 'm', 'n', 'k', 'n', 'n',
+    'n', 'n', 'y', 's', 'a', 'a', 'b', 'w', 'n', 'r', 'n', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N',
+};
+
+namespace {
+    // Last 5 bits of the complement of a letter, by the last 5 bits of the letter
+    // (which are the same in both cases), i.e. COMPLEMENT['@' + i] & 0x1F
+    alignas(32) const char LETTER_COMPLEMENT[32] = {
+        0x0E, 0x14, 0x16, 0x07, 0x08, 0x0E, 0x0E, 0x03, 0x04, 0x0E, 0x0E, 0x0D, 0x0E, 0x0B, 0x0E, 0x0E,
+        0x0E, 0x0E, 0x19, 0x13, 0x01, 0x01, 0x02, 0x17, 0x0E, 0x12, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E,
+    };
+
+#if defined(__AVX2__)
+    // x reversed and complemented, if all its bytes are letters
+    inline bool reverse_complement_32(__m256i x, __m256i &result) {
+        auto lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+        auto letters = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        if (_mm256_movemask_epi8(letters) != -1) {
+            return false;
+        }
+        const auto reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                              15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+        x = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(x, reverse), 0x4E);
+        // Shuffles look up 16 bytes (in each lane), so the tables are chosen by bit 4
+        auto low_table = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*) LETTER_COMPLEMENT));
+        auto high_table = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*) (LETTER_COMPLEMENT + 16)));
+        auto index = _mm256_and_si256(x, _mm256_set1_epi8(0x0F));
+        auto high = _mm256_cmpeq_epi8(_mm256_and_si256(x, _mm256_set1_epi8(0x10)), _mm256_set1_epi8(0x10));
+        auto bits = _mm256_blendv_epi8(_mm256_shuffle_epi8(low_table, index), _mm256_shuffle_epi8(high_table, index), high);
+        result = _mm256_or_si256(_mm256_and_si256(x, _mm256_set1_epi8((char) 0xE0)), bits);
+        return true;
+    }
+#endif
+
+#if defined(__SSSE3__)
+    inline bool reverse_complement_16(__m128i x, __m128i &result) {
+        auto lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+        auto letters = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower));
+        if (_mm_movemask_epi8(letters) != 0xFFFF) {
+            return false;
+        }
+        x = _mm_shuffle_epi8(x, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+        auto low_table = _mm_load_si128((const __m128i*) LETTER_COMPLEMENT);
+        auto high_table = _mm_load_si128((const __m128i*) (LETTER_COMPLEMENT + 16));
+        auto index = _mm_and_si128(x, _mm_set1_epi8(0x0F));
+        auto high = _mm_cmpeq_epi8(_mm_and_si128(x, _mm_set1_epi8(0x10)), _mm_set1_epi8(0x10));
+        auto bits = _mm_or_si128(_mm_andnot_si128(high, _mm_shuffle_epi8(low_table, index)),
+                                 _mm_and_si128(high, _mm_shuffle_epi8(high_table, index)));
+        result = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi8((char) 0xE0)), bits);
+        return true;
+    }
+#endif
+
+    // The comparison of s[i] with the complement of s[n - 1 - i]
+    inline int compare_complement(const char *s, std::size_t n, std::size_t i) {
+        unsigned char c = s[i], d = complement(s[n - 1 - i]);
+        return c < d ? -1 : (c > d ? 1 : 0);
+    }
+}
+
+void reverse_complement(const char *s, std::size_t n, char *out) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= n; i += 32) {
+        __m256i result;
+        if (reverse_complement_32(_mm256_loadu_si256((const __m256i*) (s + n - i - 32)), result)) {
+            _mm256_storeu_si256((__m256i*) (out + i), result);
+        } else {
+            for (std::size_t j = i; j < i + 32; j++) {
+                out[j] = complement(s[n - 1 - j]);
+            }
+        }
+    }
+#endif
+#if defined(__SSSE3__)
+    for (; i + 16 <= n; i += 16) {
+        __m128i result;
+        if (reverse_complement_16(_mm_loadu_si128((const __m128i*) (s + n - i - 16)), result)) {
+            _mm_storeu_si128((__m128i*) (out + i), result);
+        } else {
+            for (std::size_t j = i; j < i + 16; j++) {
+                out[j] = complement(s[n - 1 - j]);
+            }
+        }
     }
+#endif
+    for (; i < n; i++) {
+        out[i] = complement(s[n - 1 - i]);
+    }
+}
+
+std::string reverse_complement(const std::string &seq) {
+    std::string result(seq.length(), 'N');
+    reverse_complement(seq.data(), seq.length(), &result[0]);
     return result;
 }
 
+int compare_reverse_complement(const char *s, std::size_t n) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= n; i += 32) {
+        __m256i back;
+        if (!reverse_complement_32(_mm256_loadu_si256((const __m256i*) (s + n - i - 32)), back)) {
+            break;
+        }
+        auto equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (s + i)), back);
+        auto mask = (unsigned) _mm256_movemask_epi8(equal);
+        if (mask != 0xFFFFFFFF) {
+            return compare_complement(s, n, i + __builtin_ctz(~mask));
+        }
+    }
+#endif
+#if defined(__SSSE3__)
+    for (; i + 16 <= n; i += 16) {
+        __m128i back;
+        if (!reverse_complement_16(_mm_loadu_si128((const __m128i*) (s + n - i - 16)), back)) {
+            break;
+        }
+        auto equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (s + i)), back);
+        auto mask = (unsigned) _mm_movemask_epi8(equal);
+        if (mask != 0xFFFF) {
+            return compare_complement(s, n, i + __builtin_ctz(~mask));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        int cmp = compare_complement(s, n, i);
+        if (cmp != 0) {
+            return cmp;
+        }
+    }
+    return 0;
+}
+
+bool parse_factorization_line(const char *begin, const char *end, FactorizationLine &line) {
+    if (end > begin && end[-1] == '\r') {
+        end--;
+    }
+    auto bar = static_cast<const char*>(memchr(begin, '|', end - begin));
+    if (bar == nullptr) {
+        return false;
+    }
+
+    const char *p = begin;
+    while (p < bar && *p != ' ') {
+        p++;
+    }
+    line.read_id = begin;
+    line.read_id_length = p - begin;
+
+    while (p < bar && *p == ' ') {
+        p++;
+    }
+    bool negative = p < bar && *p == '-';
+    if (negative) {
+        p++;
+    }
+    line.offset = 0;
+    while (p < bar && *p >= '0' && *p <= '9') {
+        line.offset = line.offset * 10 + (*p - '0');
+        p++;
+    }
+    if (negative) {
+        line.offset = -line.offset;
+    }
+
+    line.factors.clear();
+    p = bar + 1;
+    while (p < end) {
+        const char *factor = p;
+        while (p < end && *p != ' ') {
+            p++;
+        }
+        line.factors.push_back(Lyndon::FactorSpan { factor, (int) (p - factor) });
+        p++;
+    }
+    return true;
+}
+
+namespace {
+    bool skip(const char *&p, const char *end, const char *token) {
+        for (; *token != '\0'; token++, p++) {
+            if (p == end || *p != *token) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool parse_int(const char *&p, const char *end, int &x) {
+        bool negative = p < end && *p == '-';
+        if (negative) {
+            p++;
+        }
+        if (p == end || *p < '0' || *p > '9') {
+            return false;
+        }
+        x = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            x = x * 10 + (*p - '0');
+            p++;
+        }
+        if (negative) {
+            x = -x;
+        }
+        return true;
+    }
+
+    // A string between single or double quotes (as Python's repr), with no escapes
+    bool parse_quoted(const char *&p, const char *end, const char *&s, int &length) {
+        if (p == end || (*p != '\'' && *p != '"')) {
+            return false;
+        }
+        auto close = static_cast<const char*>(memchr(p + 1, *p, end - p - 1));
+        if (close == nullptr) {
+            return false;
+        }
+        s = p + 1;
+        length = close - s;
+        p = close + 1;
+        return true;
+    }
+
+    // ((kf_1, ..., kf_k), 'key_seq'), also with the trailing comma of Python's 1-tuples
+    bool parse_key(const char *&p, const char *end, GraphLineKey &key) {
+        if (!skip(p, end, "((")) {
+            return false;
+        }
+        key.kf.clear();
+        while (p < end && *p != ')') {
+            int length;
+            if (!parse_int(p, end, length)) {
+                return false;
+            }
+            key.kf.push_back(length);
+            if (p < end && *p == ',') {
+                p++;
+                while (p < end && *p == ' ') {
+                    p++;
+                }
+            }
+        }
+        return skip(p, end, "), ") && parse_quoted(p, end, key.key_seq, key.key_length) && skip(p, end, ")");
+    }
+}
+
+bool parse_graph_line(const char *begin, const char *end, GraphLine &line) {
+    if (end > begin && end[-1] == '\r') {
+        end--;
+    }
+    const char *p = begin;
+    line.occurrences.clear();
+    if (skip(p, end, "ED\t")) {
+        line.is_vertex = false;
+        return parse_key(p, end, line.keys[0]) && skip(p, end, "\t") && parse_key(p, end, line.keys[1]) && p == end;
+    }
+
+    p = begin;
+    if (!skip(p, end, "VT\t") || !parse_key(p, end, line.keys[0]) || !skip(p, end, "\t{")) {
+        return false;
+    }
+    line.is_vertex = true;
+    while (p < end && *p != '}') {
+        GraphLineOccurrence occ;
+        if (!skip(p, end, "(") || !parse_quoted(p, end, occ.read_id, occ.read_id_length) || !skip(p, end, ", ")
+            || !parse_int(p, end, occ.offset) || !skip(p, end, ")")) {
+            return false;
+        }
+        line.occurrences.push_back(occ);
+        if (p < end && *p == ',') {
+            p++;
+            while (p < end && *p == ' ') {
+                p++;
+            }
+        }
+    }
+    return skip(p, end, "}") && p == end;
+}
+
+bool read_chunk(std::istream &in, std::vector<char> &chunk, std::string &rest, std::size_t size) {
+    chunk.assign(rest.begin(), rest.end());
+    rest.clear();
+
+    while (in) {
+        auto filled = chunk.size();
+        chunk.resize(filled + size);
+        in.read(chunk.data() + filled, size);
+        chunk.resize(filled + in.gcount());
+
+        auto eol = std::find(chunk.rbegin(), chunk.rend(), '\n').base();
+        if (in && eol != chunk.begin()) {
+            rest.assign(eol, chunk.end());
+            chunk.erase(eol, chunk.end());
+            break;
+        }
+    }
+    return !chunk.empty();
+}
+
 std::map<Lyndon::read_id, Lyndon::factorization> load_factorizations(const std::string& path) {
     std::ifstream in(path);
     auto result = std::map<Lyndon::read_id, Lyndon::factorization>();
 
-    std::string line;
-    while (std::getline(in, line)) {
-        auto read_id_length = line.find_first_of(' ');
-        auto read_id = line.substr(0, read_id_length);
-
-        auto idx = line.find_first_of('|') + 1;
-        auto cur_start = idx;
-        auto factors = std::vector<std::string>();
-        while (idx < line.length()) {
-            while (idx < line.length() && line[idx] != ' ') {
-                idx += 1;
+    std::vector<char> chunk;
+    std::string rest;
+    FactorizationLine line;
+    while (read_chunk(in, chunk, rest)) {
+        for_each_line(chunk, [&](const char *begin, const char *end) {
+            if (!parse_factorization_line(begin, end, line)) {
+                return;
             }
-            factors.push_back(line.substr(cur_start, idx - cur_start));
-            idx += 1;
-            cur_start = idx;
-        }
-        result[read_id] = factors;
+            auto &factors = result[Lyndon::read_id(line.read_id, line.read_id_length)];
+            factors.clear();
+            for (const auto &factor : line.factors) {
+                factors.emplace_back(factor.begin, factor.length);
+            }
+        });
     }
 
     return result;
@@ -237,24 +587,86 @@ std::map<Lyndon::read_id, Lyndon::fingerprint> load_fingerprints(const std::stri
     std::ifstream in(path);
     auto result = std::map<Lyndon::read_id, Lyndon::fingerprint>();
 
-    std::string line;
-    while (std::getline(in, line)) {
-        auto read_id_length = line.find_first_of(' ');
-        auto read_id = line.substr(0, read_id_length);
-
-        auto idx = line.find_first_of('|') + 1;
-        auto cur_start = idx;
-        auto fingerprint = std::vector<int>();
-        while (idx < line.length()) {
-            while (idx < line.length() && line[idx] != ' ') {
-                idx += 1;
+    std::vector<char> chunk;
+    std::string rest;
+    FactorizationLine line;
+    while (read_chunk(in, chunk, rest)) {
+        for_each_line(chunk, [&](const char *begin, const char *end) {
+            if (!parse_factorization_line(begin, end, line)) {
+                return;
             }
-            fingerprint.push_back(std::stoi(line.substr(cur_start, idx - cur_start)));
-            idx += 1;
-            cur_start = idx;
-        }
-        result[read_id] = fingerprint;
+            auto &fingerprint = result[Lyndon::read_id(line.read_id, line.read_id_length)];
+            fingerprint.clear();
+            for (const auto &factor : line.factors) {
+                int length = 0;
+                for (int i = 0; i < factor.length; i++) {
+                    length = length * 10 + (factor.begin[i] - '0');
+                }
+                fingerprint.push_back(length);
+            }
+        });
     }
 
     return result;
 }
+
+void append_int(std::string &out, std::int64_t x) {
+    char digits[20];
+    char *end = digits + sizeof(digits), *first = end;
+    std::uint64_t u = x < 0 ? -(std::uint64_t) x : x;
+    do {
+        *--first = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    if (x < 0) {
+        out += '-';
+    }
+    out.append(first, end);
+}
+
+void append_key(std::string &out, const Lyndon::NodeKey &key) {
+    out.append("((", 2);
+    for (int i = 0; i < key.k; i++) {
+        if (i > 0) {
+            out.append(", ", 2);
+        }
+        append_int(out, key.kf[i]);
+    }
+    out.append("), '", 4);
+    for (int i = 0; i < key.key_length; i++) {
+        out += key.key_base(i);
+    }
+    out.append("')", 2);
+}
+
+void append_edge(std::string &out, const std::string &label1, const std::string &label2) {
+    out.append("ED\t", 3);
+    out += label1;
+    out += '\t';
+    out += label2;
+    out += '\n';
+}
+
+void gzip_member(const char *data, std::size_t n, std::string &out, int level) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // 16 + 15: gzip header and trailer around a deflate stream with the largest window
+    if (deflateInit2(&stream, level, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "Cannot initialize zlib\n");
+        abort();
+    }
+
+    out.resize(deflateBound(&stream, n));
+    stream.next_in = (Bytef *) data;
+    stream.avail_in = n;
+    stream.next_out = (Bytef *) &out[0];
+    stream.avail_out = out.size();
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        fprintf(stderr, "Error while compressing\n");
+        abort();
+    }
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+}
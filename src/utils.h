@@ -4,48 +4,139 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstring>
 #include <stdarg.h>
+#include <tuple>
 #include "finger_graph.h"
 
 void log(const char * format, ...);
 
-std::tuple<int, int> remove_three(const Lyndon::fingerprint &fingerprint);
-std::tuple<int, int> up_to_ten(const Lyndon::fingerprint &fingerprint);
+// Strategies to remove the borders of a read, as in utils.py: they return the
+// range [begin, end) of the factors to keep, which is empty if begin >= end.
+typedef std::tuple<int, int> (*border_function)(const Lyndon::Range<int> &fingerprint);
+std::tuple<int, int> remove_three(const Lyndon::Range<int> &fingerprint);
+std::tuple<int, int> up_to_ten(const Lyndon::Range<int> &fingerprint);
+std::tuple<int, int> twenty_most(const Lyndon::Range<int> &fingerprint);
+border_function get_border_function(const std::string &name);
 
 std::string v2s(const std::vector<int> &v, const std::string &sep=" ");
-std::string map2str(const std::map<Lyndon::Occurrence, std::string> &m);
-std::string set2str(const std::set<Lyndon::Occurrence> &occs);
+std::string map2str(const std::map<Lyndon::Occurrence, std::string> &m, const Lyndon::ReadTable &reads);
+std::string set2str(const Lyndon::Range<Lyndon::Occurrence> &occs, const Lyndon::ReadTable &reads);
 std::vector<std::string> split(const std::string &s, char delim);
 std::string join(const std::vector<std::string> &v, std::string s, int start = 0, int end = -1);
 std::vector<int> vecstr2vecint(const std::vector<std::string> &vs);
 
 Lyndon::fingerprint facts2fingerprint(const std::vector<std::string> &facts);
+Lyndon::factorization fingerprint2facts(const std::string &s, const Lyndon::fingerprint &fingerprint, int start = 0);
 
 std::string &ltrim(std::string &str, const std::string &chars = "\t\n\v\f\r ");
 std::string &rtrim(std::string &str, const std::string &chars = "\t\n\v\f\r ");
 std::string &trim(std::string &str, const std::string &chars = "\t\n\v\f\r ");
 int sum(const std::vector<int> &v, int start = 0, int end = -1);
+int sum(const Lyndon::Range<int> &v, int start = 0, int end = -1);
+
+// Lines of the text format of the graph, as written by FingerGraph::save
+void append_int(std::string &out, std::int64_t x);
+// ((kf_1, ..., kf_k), 'key_seq')
+void append_key(std::string &out, const Lyndon::NodeKey &key);
+// ED\t((kf1), 'key_seq1')\t((kf2), 'key_seq2'), given the two keys already formatted
+void append_edge(std::string &out, const std::string &label1, const std::string &label2);
+// {('read_id', offset), ...}, where `reads` is any table of read names with
+// name(r_id) and length(r_id)
+template <class Reads> void append_occurrences(std::string &out, const Lyndon::Range<Lyndon::Occurrence> &occs,
+                                               const Reads &reads) {
+    out += '{';
+    bool first = true;
+    for (const auto &occ : occs) {
+        if (!first) {
+            out.append(", ", 2);
+        }
+        first = false;
+        out.append("('", 2);
+        out.append(reads.name(occ.r_id), reads.length(occ.r_id));
+        out.append("', ", 3);
+        append_int(out, occ.offset);
+        out += ')';
+    }
+    out += '}';
+}
+
+// VT\t((kf), 'key_seq')\t{('read_id', offset), ...}
+template <class Reads> void append_vertex(std::string &out, const Lyndon::NodeKey &key,
+                                          const Lyndon::Range<Lyndon::Occurrence> &occs, const Reads &reads) {
+    out.append("VT\t", 3);
+    append_key(out, key);
+    out += '\t';
+    append_occurrences(out, occs, reads);
+    out += '\n';
+}
+
+// Compresses data[0, n) into a gzip member, stored in `out`. Concatenated members
+// are a valid gzip file, so separate blocks can be compressed in parallel.
+void gzip_member(const char *data, std::size_t n, std::string &out, int level = 6);
+
+// A line `read_id offset|f1 f2 ...` of a factorizations file, parsed in place:
+// the read id and the factors point into the line.
+struct FactorizationLine {
+    const char *read_id;
+    int read_id_length;
+    int offset;
+    Lyndon::factor_spans factors;
+};
+bool parse_factorization_line(const char *begin, const char *end, FactorizationLine &line);
+
+// A line `VT\tkey\t{('read_id', offset), ...}` or `ED\tkey1\tkey2` of a graph
+// (as written by append_vertex and append_edge), parsed in place: the key
+// sequences and the read ids point into the line.
+struct GraphLineKey {
+    Lyndon::k_finger kf;
+    const char *key_seq;
+    int key_length;
+};
+struct GraphLineOccurrence {
+    const char *read_id;
+    int read_id_length;
+    int offset;
+};
+struct GraphLine {
+    bool is_vertex;
+    GraphLineKey keys[2];   // the vertex, or the two ends of the edge
+    std::vector<GraphLineOccurrence> occurrences;
+};
+bool parse_graph_line(const char *begin, const char *end, GraphLine &line);
+
+// Reads about `size` bytes of whole lines from `in` into `chunk`, carrying the
+// trailing partial line over to the next call in `rest`. Returns false once the
+// input is over.
+bool read_chunk(std::istream &in, std::vector<char> &chunk, std::string &rest, std::size_t size = 1 << 20);
+template <class F> void for_each_line(const std::vector<char> &chunk, F f) {
+    const char *begin = chunk.data(), *end = begin + chunk.size();
+    while (begin < end) {
+        auto eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+        if (eol == nullptr) {
+            eol = end;
+        }
+        f(begin, eol);
+        begin = eol + 1;
+    }
+}
 
 std::map<Lyndon::read_id, Lyndon::factorization> load_factorizations(const std::string& path);
 std::map<Lyndon::read_id, Lyndon::fingerprint> load_fingerprints(const std::string& path);
 
-std::string reverse_complement(const std::string &seq);
+// Complement of every byte: the IUPAC codes (and U) in either case, keeping the
+// case, and 'N' for anything else
+extern const char COMPLEMENT[256];
 inline char complement(char c) {
-    switch (c) {
-        case 'A':
-            return 'T';
-        case 'C':
-            return 'G';
-        case 'G':
-            return 'C';
-        case 'T':
-            return 'A';
-        case 'N':
-            return 'N';
-        default:
-            abort();
-    }
+    return COMPLEMENT[(unsigned char) c];
 }
+// out[0, n) = reverse complement of s[0, n), which must not overlap. Built with
+// -mavx2 or -mssse3, letters are complemented 32 or 16 at a time.
+void reverse_complement(const char *s, std::size_t n, char *out);
+std::string reverse_complement(const std::string &seq);
+// Sign of the comparison of s[0, n) with its reverse complement, found without
+// building the latter (0 if they are the same)
+int compare_reverse_complement(const char *s, std::size_t n);
 
 template <class T> std::vector<T> slice(const std::vector<T> &v, int start = 0, int end = -1) {
     {
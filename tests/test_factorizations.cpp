@@ -0,0 +1,124 @@
+// Checks factorize_batch against the factorizations of one read at a time.
+// Built with the sources of finger-graph but main.cpp (see the README).
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "factorizations.h"
+#include "utils.h"
+
+namespace {
+    const char *ALGS[] = { "cfl", "icfl", "cfl_icfl", "cfl_comb", "icfl_comb", "cfl_icfl_comb" };
+
+    // Random reads, low-complexity ones (homopolymers, microsatellites) and
+    // reads with N and lower case bases, of every length from 0
+    std::vector<std::string> make_reads() {
+        std::mt19937 random(42);
+        std::vector<std::string> reads;
+        for (int n = 0; n < 400; n++) {
+            std::string read;
+            auto alphabet = n % 4 == 3 ? std::string("ACGTNacgt") : std::string("ACGT");
+            for (int i = 0; i < n; i++) {
+                read += alphabet[random() % alphabet.size()];
+            }
+            reads.push_back(read);
+
+            std::string repeat;
+            for (int i = 0; i < 1 + n % 6; i++) {
+                repeat += "ACGT"[random() % 4];
+            }
+            read.clear();
+            while ((int) read.length() < n) {
+                read += repeat;
+                if (random() % 8 == 0) {
+                    read += "ACGT"[random() % 4];
+                }
+            }
+            reads.push_back(read.substr(0, n));
+        }
+        return reads;
+    }
+
+    Lyndon::factorization factorize_string(const std::string &alg, const std::string &s) {
+        if (alg == "cfl") return cfl(s);
+        if (alg == "icfl") return icfl(s);
+        if (alg == "cfl_icfl") return cfl_icfl(s);
+        if (alg == "cfl_comb") return d_cfl(s);
+        if (alg == "icfl_comb") return d_icfl(s);
+        return d_cfl_icfl(s);
+    }
+
+    bool equal(const Lyndon::Range<int> &x, const Lyndon::fingerprint &y) {
+        return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+    }
+}
+
+int main() {
+    auto reads = make_reads();
+    int failures = 0;
+    for (auto name : ALGS) {
+        auto alg = get_factorization_function(name);
+        Lyndon::FactorizationBatch batch;
+
+        // Batches of different sizes through the same buffers, the last ones
+        // appended without clearing the batch
+        for (std::size_t first = 0, size = 1; first < reads.size(); first += size, size = size * 2 % 97 + 1) {
+            auto count = std::min(size, reads.size() - first);
+            std::vector<const char*> s;
+            std::vector<int> n;
+            for (auto r = first; r < first + count; r++) {
+                s.push_back(reads[r].data());
+                n.push_back(reads[r].length());
+            }
+            auto appended = first >= reads.size() / 2 ? batch.size() : 0;
+            if (appended == 0) {
+                batch.clear();
+            }
+            factorize_batch(alg, s.data(), n.data(), count, batch);
+            if (batch.size() != appended + count) {
+                fprintf(stderr, "%s: batch of %zu reads holds %zu\n", name, appended + count, batch.size());
+                failures++;
+                continue;
+            }
+
+            for (std::size_t i = 0; i < count; i++) {
+                const auto &read = reads[first + i];
+                Lyndon::FactorizationWorkspace ws;
+                Lyndon::fingerprint lengths;
+                alg(read.data(), read.length(), lengths, ws);
+                auto strings = facts2fingerprint(factorize_string(name, read));
+                if (!equal(batch.factors(appended + i), lengths) || lengths != strings) {
+                    fprintf(stderr, "%s: read %zu (%s) is factorized differently in a batch\n", name, first + i,
+                            read.c_str());
+                    failures++;
+                }
+            }
+        }
+
+        // Factorizing the same batch again does not grow the buffers
+        std::vector<const char*> s;
+        std::vector<int> n;
+        for (const auto &read : reads) {
+            s.push_back(read.data());
+            n.push_back(read.length());
+        }
+        batch.clear();
+        factorize_batch(alg, s.data(), n.data(), reads.size(), batch);
+        auto capacities = std::make_pair(batch.lengths.capacity(), batch.offsets.capacity());
+        batch.clear();
+        factorize_batch(alg, s.data(), n.data(), reads.size(), batch);
+        if (std::make_pair(batch.lengths.capacity(), batch.offsets.capacity()) != capacities) {
+            fprintf(stderr, "%s: the buffers of a reused batch grow\n", name);
+            failures++;
+        }
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "factorize_batch agrees with the factorizations of %zu reads\n", reads.size());
+    return 0;
+}
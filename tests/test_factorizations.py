@@ -0,0 +1,70 @@
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import unittest
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(ROOT, 'python'))
+from factorization import cfl, icfl, cfl_icfl, d_cfl, d_icfl, d_cfl_icfl
+from utils import twenty_most, remove_three, up_to_ten
+
+FINGER_GRAPH = os.environ.get('FINGER_GRAPH', os.path.join(ROOT, 'finger-graph'))
+
+ALGS = {'cfl': cfl, 'icfl': icfl, 'cfl_icfl': cfl_icfl,
+        'cfl_comb': d_cfl, 'icfl_comb': d_icfl, 'cfl_icfl_comb': d_cfl_icfl}
+BORDERS = {None: None, 'remove-three': remove_three, 'up-to-ten': up_to_ten, 'twenty-most': twenty_most}
+
+
+def reference_factorizations(reads, alg, border):
+    """Lines of python/compute_factorizations.py for the reads, as (name, sequence) pairs"""
+    lines = []
+    for name, seq in reads:
+        factors = alg(seq)
+        if border is None:
+            lines.append('%s 0|%s' % (name, ' '.join(factors)))
+            continue
+        l, _, r = border([len(x) for x in factors])
+        mid = factors[len(l):-len(r)]
+        if mid:
+            lines.append('%s %d|%s' % (name, sum(l), ' '.join(mid)))
+    return lines
+
+
+class FactorizeTest(unittest.TestCase):
+    def test_factorize(self):
+        random.seed(1)
+        reads = []
+        for r in range(60):
+            length = random.choice([1, 2, 5, 12, 40, 150, 300])
+            # Some reads are repeats of a short word, some have runs of N
+            if r % 5 == 0:
+                word = ''.join(random.choice('ACGT') for _ in range(random.randint(1, 4)))
+                seq = (word * length)[:length]
+            else:
+                seq = ''.join(random.choice('ACGT') for _ in range(length))
+            if r % 3 == 0:
+                begin = random.randrange(length)
+                seq = seq[:begin] + 'N' * random.randint(1, 5) + seq[begin + 1:]
+            reads.append(('r%d' % r, seq))
+
+        with tempfile.TemporaryDirectory() as tmp:
+            fasta = os.path.join(tmp, 'reads.fa')
+            with open(fasta, 'w') as f:
+                for name, seq in reads:
+                    f.write('>%s\n%s\n' % (name, seq))
+
+            for alg_name, alg in ALGS.items():
+                for border_name, border in BORDERS.items():
+                    args = [FINGER_GRAPH, 'factorize', '-a', alg_name]
+                    if border_name is not None:
+                        args += ['-b', border_name]
+                    out = subprocess.run(args + [fasta], check=True, stdout=subprocess.PIPE,
+                                         stderr=subprocess.DEVNULL, universal_newlines=True).stdout
+                    with self.subTest(alg=alg_name, border=border_name):
+                        self.assertEqual(out.splitlines(), reference_factorizations(reads, alg, border))
+
+
+if __name__ == '__main__':
+    unittest.main()
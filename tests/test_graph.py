@@ -0,0 +1,270 @@
+import gzip
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import types
+import unittest
+from ast import literal_eval
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(ROOT, 'python'))
+try:
+    import tqdm
+except ImportError:
+    # lyndon.py only uses tqdm for progress bars
+    tqdm = types.ModuleType('tqdm')
+    tqdm.tqdm = lambda iterable, **kwargs: iterable
+    sys.modules['tqdm'] = tqdm
+from lyndon import DBG
+from graph_file import GraphFile
+from utils import reverse_complement
+
+FINGER_GRAPH = os.environ.get('FINGER_GRAPH', os.path.join(ROOT, 'finger-graph'))
+
+
+def run(*args):
+    return subprocess.run([FINGER_GRAPH] + list(args), check=True, stdout=subprocess.PIPE,
+                          stderr=subprocess.DEVNULL, universal_newlines=True).stdout
+
+
+def read_file(path):
+    with open(path) as f:
+        return f.read()
+
+
+def parse_graph(text):
+    """Header, nodes as {occurrences: k-finger} and edges as pairs of occurrences of a text graph"""
+    lines = text.splitlines()
+    header = dict(field.split('=') for field in lines[0].split('\t')[1:])
+    nodes, keys, edges = {}, {}, []
+    for line in lines[1:]:
+        type_, *rest = line.split('\t')
+        if type_ == 'VT':
+            key, occs = literal_eval(rest[0]), frozenset(literal_eval(rest[1]))
+            nodes[occs] = key[0]
+            keys[key] = occs
+        elif type_ == 'ED':
+            edges.append((keys[literal_eval(rest[0])], keys[literal_eval(rest[1])]))
+    return header, nodes, edges
+
+
+def write_graph(path, k, is_normalized, kfs, edges):
+    """Text graph with nodes named by kfs (name -> k-finger), each one occurring twice in the read of its name"""
+    with open(path, 'w') as f:
+        f.write('HT\tk=%d\tthreshold=1\tis_normalized=%d\tis_enriched=0\n' % (k, is_normalized))
+        for name, kf in kfs.items():
+            f.write("VT\t(%s, 'ACGT')\t{('%s', 0), ('%s', 1)}\n" % (kf, name, name))
+        for x, y in edges:
+            for a, b in [(x, y)] if not is_normalized else [(x, y), (y, x)]:
+                f.write("ED\t(%s, 'ACGT')\t(%s, 'ACGT')\n" % (kfs[a], kfs[b]))
+
+
+def reference_components(nodes, edges, is_directed):
+    """Components of the nodes found by DBG.findCC, as sets of occurrences"""
+    g = DBG(_empty=True)
+    g.is_directed = is_directed
+    dbg_nodes = {}
+    for occs, kf in nodes.items():
+        dbg_nodes[occs] = g.nodes[occs] = DBG.Node(kf, occs)
+        dbg_nodes[occs].seqs = dict.fromkeys(occs)
+    for x, y in edges:
+        g.add_edge(dbg_nodes[x], dbg_nodes[y])
+    return [frozenset(occ for node in cc for occ in node.seqs) for cc in g.findCC()]
+
+
+def reference_unitigs(nodes, edges, is_directed):
+    """Unitigs as {occurrences: fingerprint}, the fingerprint being None for cycles"""
+    LEFT, RIGHT = 0, 1
+
+    def follows(x, y):
+        return x[1:] == y[:-1]
+
+    # Arcs on each side of the nodes, as (node, side reached), None blocking the side
+    arcs = {(x, side): [] for x in nodes for side in (LEFT, RIGHT)}
+    for x, y in set(edges):
+        if is_directed:
+            arcs[x, RIGHT].append((y, LEFT))
+            arcs[y, LEFT].append((x, RIGHT))
+            continue
+        kx, ky = nodes[x], nodes[y]
+        overlaps = [(RIGHT, LEFT, follows(kx, ky)), (RIGHT, RIGHT, follows(kx, ky[::-1])),
+                    (LEFT, RIGHT, follows(ky, kx)), (LEFT, LEFT, follows(ky[::-1], kx))]
+        sides = [(a, b) for a, b, matches in overlaps if matches]
+        if x == y or len(sides) != 1:
+            arcs[x, LEFT].append(None)
+            arcs[x, RIGHT].append(None)
+        else:
+            arcs[x, sides[0][0]].append((y, sides[0][1]))
+
+    def merged(x, side):
+        if len(arcs[x, side]) != 1 or arcs[x, side][0] is None:
+            return None
+        y, side_y = arcs[x, side][0]
+        return (y, side_y) if y != x and len(arcs[y, side_y]) == 1 else None
+
+    def walk(s, side):
+        path, fingerprint = [s], list(nodes[s] if side == RIGHT else nodes[s][::-1])
+        arc = merged(s, side)
+        while arc is not None and arc[0] != s:
+            y, side_y = arc
+            path.append(y)
+            fingerprint.append(nodes[y][-1] if side_y == LEFT else nodes[y][0])
+            arc = merged(y, 1 - side_y)
+        return path, tuple(fingerprint)
+
+    unitigs, seen = {}, set()
+    for x in nodes:
+        left, right = merged(x, LEFT) is not None, merged(x, RIGHT) is not None
+        if left and (right or is_directed):
+            continue
+        path, fingerprint = walk(x, LEFT if left else RIGHT)
+        seen.update(path)
+        # Chains of an undirected graph may be read from either end
+        unitigs[frozenset().union(*path)] = fingerprint if is_directed else min(fingerprint, fingerprint[::-1])
+    for x in nodes:
+        if x not in seen:
+            path, _ = walk(x, RIGHT)
+            seen.update(path)
+            unitigs[frozenset().union(*path)] = None
+    return unitigs
+
+
+class GraphTest(unittest.TestCase):
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def path(self, name):
+        return os.path.join(self.tmp.name, name)
+
+    def check_components(self, graph, nodes, edges, is_directed):
+        lines = [line.split('\t') for line in run('components', '-g', graph).splitlines()]
+        sizes = [int(line[1]) for line in lines]
+        self.assertEqual(sizes, sorted(sizes, reverse=True))
+        reads = sorted(sorted(line[3].split(' ')) for line in lines)
+        expected = reference_components(nodes, edges, is_directed)
+        self.assertEqual(sorted(sizes), sorted(sum(1 for x in nodes if x <= cc) for cc in expected))
+        self.assertEqual(reads, sorted(sorted({occ[0] for occ in cc}) for cc in expected))
+
+        # Clusters join the components sharing a read
+        clusters = {}
+        for line in run('components', '-g', graph, '--clusters').splitlines():
+            read, cluster = line.split('\t')
+            clusters.setdefault(cluster, set()).add(read)
+        expected_clusters = []
+        for cc in expected:
+            cluster = {occ[0] for occ in cc}
+            for other in [c for c in expected_clusters if c & cluster]:
+                cluster |= other
+                expected_clusters.remove(other)
+            expected_clusters.append(cluster)
+        self.assertEqual(sorted(map(sorted, clusters.values())), sorted(map(sorted, expected_clusters)))
+
+    def check_unitigs(self, graph, nodes, edges, is_directed):
+        k = len(next(iter(nodes.values())))
+        expected = reference_unitigs(nodes, edges, is_directed)
+        unitigs = {}
+        for line in run('compact', '-g', graph).splitlines():
+            if line.startswith('UT'):
+                _, _, fingerprint, n_nodes, occs = line.split('\t')
+                fingerprint, occs = literal_eval(fingerprint), frozenset(literal_eval(occs))
+                self.assertEqual(len(fingerprint), k + int(n_nodes) - 1)
+                self.assertIn(occs, expected)
+                if expected[occs] is None:
+                    unitigs[occs] = None
+                else:
+                    unitigs[occs] = fingerprint if is_directed else min(fingerprint, fingerprint[::-1])
+        self.assertEqual(unitigs, expected)
+
+    def check_fixture(self, kfs, edges, is_normalized):
+        graph = self.path('graph.txt')
+        write_graph(graph, 3, is_normalized, kfs, edges)
+        _, nodes, node_edges = parse_graph(read_file(graph))
+        self.check_components(graph, nodes, node_edges, not is_normalized)
+        self.check_unitigs(graph, nodes, node_edges, not is_normalized)
+        return reference_unitigs(nodes, node_edges, not is_normalized)
+
+    def test_directed(self):
+        kfs = {
+            # A chain ending in a node with two successors
+            'a': (1, 2, 3), 'b': (2, 3, 4), 'c': (3, 4, 5), 'd': (4, 5, 6), 'e': (4, 5, 7),
+            # Two predecessors of h, then a chain
+            'f': (9, 9, 8), 'g': (1, 9, 8), 'h': (9, 8, 7), 'i': (8, 7, 6), 'j': (7, 6, 5),
+            # A cycle, a self loop and a lone node
+            'p': (10, 11, 12), 'q': (11, 12, 10), 'r': (12, 10, 11), 's': (13, 13, 13), 't': (14, 15, 16),
+        }
+        edges = [('a', 'b'), ('b', 'c'), ('c', 'd'), ('c', 'e'), ('f', 'h'), ('g', 'h'), ('h', 'i'), ('i', 'j'),
+                 ('p', 'q'), ('q', 'r'), ('r', 'p'), ('s', 's')]
+        unitigs = self.check_fixture(kfs, edges, False)
+        by_reads = {frozenset(occ[0] for occ in occs): fingerprint for occs, fingerprint in unitigs.items()}
+        self.assertEqual(by_reads, {
+            frozenset('abc'): (1, 2, 3, 4, 5), frozenset('d'): (4, 5, 6), frozenset('e'): (4, 5, 7),
+            frozenset('f'): (9, 9, 8), frozenset('g'): (1, 9, 8), frozenset('hij'): (9, 8, 7, 6, 5),
+            frozenset('pqr'): None, frozenset('s'): (13, 13, 13), frozenset('t'): (14, 15, 16),
+        })
+
+    def test_undirected(self):
+        kfs = {
+            # x - y - z with z overlapping y backwards, v branching off the right of y,
+            # and w overlapping the left of z
+            'x': (1, 2, 3), 'y': (2, 3, 4), 'z': (1, 4, 3), 'v': (3, 4, 9), 'w': (2, 1, 4),
+            # k-fingers overlapping in two ways
+            'u1': (1, 1, 2), 'u2': (1, 2, 1),
+            # A cycle, of the k-fingers (11, 12, 13), (12, 13, 11) and (13, 11, 12) normalized
+            'p': (11, 12, 13), 'q': (11, 13, 12), 'r': (12, 11, 13),
+        }
+        edges = [('x', 'y'), ('y', 'z'), ('y', 'v'), ('z', 'w'), ('u1', 'u2'),
+                 ('p', 'q'), ('q', 'r'), ('r', 'p')]
+        unitigs = self.check_fixture(kfs, edges, True)
+        by_reads = {frozenset(occ[0] for occ in occs): fingerprint for occs, fingerprint in unitigs.items()}
+        self.assertEqual(by_reads, {
+            frozenset('xy'): (1, 2, 3, 4), frozenset('zw'): (2, 1, 4, 3), frozenset('v'): (3, 4, 9),
+            frozenset({'u1'}): (1, 1, 2), frozenset({'u2'}): (1, 2, 1), frozenset('pqr'): None,
+        })
+
+    def test_built_graphs(self):
+        random.seed(0)
+        genome = ''.join(random.choice('ACGT') for _ in range(3000))
+        fasta = self.path('reads.fa')
+        with open(fasta, 'w') as f:
+            for r in range(80):
+                begin = random.randrange(len(genome) - 400)
+                read = genome[begin:begin + 400]
+                f.write('>r%d\n%s\n' % (r, read if r % 2 else reverse_complement(read)))
+
+        for options in [], ['--no-norm']:
+            text, gz, binary = self.path('graph.txt'), self.path('graph.txt.gz'), self.path('graph.bin')
+            run('-k', '3', '-t', '2', *options, '--fasta', fasta, '-o', text)
+            run('-k', '3', '-t', '2', *options, '--fasta', fasta, '-o', gz)
+            run('-k', '3', '-t', '2', *options, '--fasta', fasta, '-o', binary, '--binary')
+            text_graph = read_file(text)
+            header, nodes, edges = parse_graph(text_graph)
+            self.assertGreater(len(edges), 100)
+
+            # The loaders read back the same graph
+            with gzip.open(gz, 'rt') as f:
+                self.assertEqual(f.read(), text_graph)
+            self.assertEqual(run('view', binary), text_graph)
+            self.assertEqual(run('view', text), text_graph)
+            g = GraphFile(binary)
+            self.assertEqual(len(g), len(nodes))
+            keys = [g.key(i) for i in range(len(g))]
+            self.assertEqual({frozenset(g.occurrences(i)): keys[i][0] for i in range(len(g))}, nodes)
+            # Text graphs list the edges of undirected graphs twice
+            self.assertEqual({(frozenset(g.occurrences(i)), frozenset(g.occurrences(j)))
+                              for i in range(len(g)) for j in g.neighbours(i)}, set(edges))
+            for graph in gz, binary:
+                self.assertEqual(run('components', '-g', graph), run('components', '-g', text))
+                self.assertEqual(run('compact', '-g', graph), run('compact', '-g', text))
+
+            is_directed = header['is_normalized'] == '0'
+            self.check_components(text, nodes, edges, is_directed)
+            self.check_unitigs(text, nodes, edges, is_directed)
+
+
+if __name__ == '__main__':
+    unittest.main()